@@ -5,11 +5,10 @@
 #include "ssd1306.h"
 #include "ssd1309.h"  
 #include "ssd1331.h"
-#include "font.h"
+#include "font_atlas.h"
 #include "maple.h"
 
 // External variables
-extern tFont Font;  // From font.c
 extern uint16_t color;
 
 // Framebuffer for monochrome displays (SSD1306/SSD1309)
@@ -19,6 +18,153 @@ uint8_t frameBuffer[SSD1309_FRAMEBUFFER_SIZE];  // 1024 bytes for 128x64
 // Remove the conflicting extern declaration for oledType
 // We'll access it via the flashData[21] macro directly
 
+// Dirty column range per band, valid where the band's bit is set
+static uint8_t dirtyBands;
+static uint8_t dirtyX0[DISPLAY_BANDS];
+static uint8_t dirtyX1[DISPLAY_BANDS];
+
+void displayMarkDirty(int x0, int y0, int x1, int y1) {
+    if (y0 < 0) y0 = 0;
+    if (y1 >= DISPLAY_BANDS * DISPLAY_BAND_ROWS) y1 = DISPLAY_BANDS * DISPLAY_BAND_ROWS - 1;
+    if (x0 < 0) x0 = 0;
+    if (x1 > 255) x1 = 255;
+    if (x0 > x1 || y0 > y1) return;
+    
+    for (int band = y0 / DISPLAY_BAND_ROWS; band <= y1 / DISPLAY_BAND_ROWS; band++) {
+        uint8_t bit = 1 << band;
+        if (!(dirtyBands & bit)) {
+            dirtyBands |= bit;
+            dirtyX0[band] = x0;
+            dirtyX1[band] = x1;
+        } else {
+            if (x0 < dirtyX0[band]) dirtyX0[band] = x0;
+            if (x1 > dirtyX1[band]) dirtyX1[band] = x1;
+        }
+    }
+}
+
+void displayMarkAllDirty(void) {
+    int width, height;
+    getDisplayDimensions(&width, &height);
+    displayMarkDirty(0, 0, width - 1, height - 1);
+}
+
+bool displayTakeDirtyBand(int band, int *x0, int *x1) {
+    uint8_t bit = 1 << band;
+    if (!(dirtyBands & bit)) {
+        return false;
+    }
+    dirtyBands &= ~bit;
+    *x0 = dirtyX0[band];
+    *x1 = dirtyX1[band];
+    return true;
+}
+
+static bool columnDiffers(const uint8_t *now, const uint8_t *shown, int stride, int rows, int bytes_per_column, int x) {
+    for (int r = 0; r < rows; r++) {
+        int i = r * stride + x * bytes_per_column;
+        if (memcmp(&now[i], &shown[i], bytes_per_column) != 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Clearing and redrawing the same text marks a lot, very little of it actually changes
+bool displayTrimSpan(const uint8_t *now, const uint8_t *shown, int stride, int rows,
+                     int bytes_per_column, int *x0, int *x1) {
+    while (*x0 <= *x1 && !columnDiffers(now, shown, stride, rows, bytes_per_column, *x0)) (*x0)++;
+    while (*x1 >= *x0 && !columnDiffers(now, shown, stride, rows, bytes_per_column, *x1)) (*x1)--;
+    return *x0 <= *x1;
+}
+
+// Drawing for the monochrome panels, shared by their drivers. fb is pages of 8 rows, a byte
+// per column, bit 0 on top
+
+void displayMonoFillRect(uint8_t *fb, int width, int height, int x, int y, int w, int h, uint16_t color) {
+    int sx, sy;
+    if (!displayClip(width, height, &x, &y, &w, &h, &sx, &sy)) return;
+
+    // A page at a time, every column of it with one mask
+    for (int row = y; row < y + h;) {
+        int page = row >> 3;
+        int end = (page + 1) * 8 < y + h ? (page + 1) * 8 : y + h;
+        uint8_t mask = (0xFF << (row & 7)) & (0xFF >> (8 - (end - page * 8)));
+        uint8_t *dst = &fb[page * width + x];
+        for (int i = 0; i < w; i++) {
+            if (color)
+                dst[i] |= mask;
+            else
+                dst[i] &= ~mask;
+        }
+        row = end;
+    }
+    displayMarkDirty(x, y, x + w - 1, y + h - 1);
+}
+
+void displayMonoBlit1bpp(uint8_t *fb, int width, int height, int x, int y, int w, int h,
+                         const uint8_t *bits, int stride, uint16_t color) {
+    int sx, sy;
+    if (!displayClip(width, height, &x, &y, &w, &h, &sx, &sy)) return;
+
+    for (int r = 0; r < h; r++) {
+        const uint8_t *src = &bits[(sy + r) * stride];
+        uint8_t *dst = &fb[((y + r) >> 3) * width + x];
+        uint8_t mask = 1 << ((y + r) & 7);
+        for (int i = 0; i < w; i++) {
+            int bit = sx + i;
+            if (!(src[bit >> 3] & (1 << (bit & 7)))) continue;
+            if (color)
+                dst[i] |= mask;
+            else
+                dst[i] &= ~mask;
+        }
+    }
+    displayMarkDirty(x, y, x + w - 1, y + h - 1);
+}
+
+// Lit wherever the source isn't black
+void displayMonoBlitRGB565(uint8_t *fb, int width, int height, int x, int y, int w, int h,
+                           const uint16_t *pixels) {
+    int sx, sy;
+    int stride = w;
+    if (!displayClip(width, height, &x, &y, &w, &h, &sx, &sy)) return;
+
+    for (int r = 0; r < h; r++) {
+        const uint16_t *src = &pixels[(sy + r) * stride + sx];
+        uint8_t *dst = &fb[((y + r) >> 3) * width + x];
+        uint8_t mask = 1 << ((y + r) & 7);
+        for (int i = 0; i < w; i++) {
+            if (src[i])
+                dst[i] |= mask;
+            else
+                dst[i] &= ~mask;
+        }
+    }
+    displayMarkDirty(x, y, x + w - 1, y + h - 1);
+}
+
+// Each atlas column shifted to the row within its page, then ORed into up to three pages
+void displayMonoPutGlyph(uint8_t *fb, int width, int height, int x, int y, uint8_t c, uint16_t color) {
+    const uint16_t *columns = fontColumns[fontIndex(c)];
+    int page = y >> 3;
+    int shift = y & 7;
+
+    for (int i = 0; i < FONT_WIDTH; i++) {
+        int col = x + i;
+        if (col < 0 || col >= width) continue;
+        uint32_t bits = (uint32_t)columns[i] << shift;
+        for (int p = page; bits; p++, bits >>= 8) {
+            if (p < 0 || p >= height / 8) continue;
+            if (color)
+                fb[p * width + col] |= bits & 0xFF;
+            else
+                fb[p * width + col] &= ~(bits & 0xFF);
+        }
+    }
+    displayMarkDirty(x, y, x + FONT_WIDTH - 1, y + FONT_HEIGHT - 1);
+}
+
 // Updated OLED detection logic
 uint8_t detect_oled_type(void) {
     // Check OLED_PIN (22) for display type selection
@@ -31,200 +177,84 @@ uint8_t detect_oled_type(void) {
     }
 }
 
+// Chosen by displayInit(), everything else goes through it
+static const display_driver_t *driver = &ssd1306Driver;
+
 // Enhanced display initialization with SSD1309 support
 void displayInit() {
     flashData[21] = detect_oled_type();  // Set oledType directly
     
     switch(flashData[21]) {  // Use flashData[21] instead of oledType
         case DISPLAY_SSD1306:
-            ssd1306_init();
+            driver = &ssd1306Driver;
             break;
         case DISPLAY_SSD1331:
-            ssd1331_init();
+            driver = &ssd1331Driver;
             break;
         case DISPLAY_SSD1309:
-            ssd1309_init();
+            driver = &ssd1309Driver;
             break;
         default:
             // Fallback to SSD1306
-            ssd1306_init();
+            driver = &ssd1306Driver;
             flashData[21] = DISPLAY_SSD1306;
             break;
     }
+    driver->init();
+}
+
+const display_driver_t *displayDriver(void) {
+    return driver;
 }
 
 void updateDisplay() {
-    switch(flashData[21]) {
-        case DISPLAY_SSD1306:
-            updateSSD1306();
-            break;
-        case DISPLAY_SSD1331:
-            updateSSD1331();
-            break;
-        case DISPLAY_SSD1309:
-            updateSSD1309();
-            break;
-        default:
-            updateSSD1306();
-            break;
-    }
+    driver->update();
 }
 
 void clearDisplay() {
-    switch(flashData[21]) {
-        case DISPLAY_SSD1306:
-            clearSSD1306();
-            break;
-        case DISPLAY_SSD1331:
-            clearSSD1331();
-            break;
-        case DISPLAY_SSD1309:
-            clearSSD1309();
-            break;
-        default:
-            clearSSD1306();
-            break;
-    }
+    driver->clear();
 }
 
 void splashDisplay() {
-    switch(flashData[21]) {
-        case DISPLAY_SSD1306:
-            splashSSD1306();
-            break;
-        case DISPLAY_SSD1331:
-            splashSSD1331();
-            break;
-        case DISPLAY_SSD1309:
-            splashSSD1309();
-            break;
-        default:
-            splashSSD1306();
-            break;
-    }
+    driver->splash();
 }
 
 // Unified pixel setting function
 void setDisplayPixel(int x, int y, bool on) {
-    switch(flashData[21]) {
-        case DISPLAY_SSD1306:
-            setPixelSSD1306(x, y, on);
-            break;
-        case DISPLAY_SSD1331:
-            // SSD1331 uses different parameters (color instead of bool)
-            setPixelSSD1331(x, y, on ? color : 0);
-            break;
-        case DISPLAY_SSD1309:
-            setPixelSSD1309(x, y, on);
-            break;
-        default:
-            setPixelSSD1306(x, y, on);
-            break;
-    }
+    driver->set_pixel(x, y, on ? color : 0);
+}
+
+void displayFillRect(int x, int y, int w, int h, uint16_t color) {
+    driver->fill_rect(x, y, w, h, color);
+}
+
+void displayBlit1bpp(int x, int y, int w, int h, const uint8_t *bits, int stride, uint16_t color) {
+    driver->blit_1bpp(x, y, w, h, bits, stride, color);
+}
+
+void displayBlitRGB565(int x, int y, int w, int h, const uint16_t *pixels) {
+    driver->blit_rgb565(x, y, w, h, pixels);
 }
 
 // Get display type string for menu display
 const char* getDisplayTypeString() {
-    switch(flashData[21]) {
-        case DISPLAY_SSD1306:
-            return "SSD1306";
-        case DISPLAY_SSD1331:
-            return "SSD1331";
-        case DISPLAY_SSD1309:
-            return "SSD1309";
-        default:
-            return "Unknown";
-    }
+    return driver->name;
 }
 
 // Check if display supports color (for menu options)
 bool displaySupportsColor() {
-    return (flashData[21] == DISPLAY_SSD1331);
+    return driver->color;
 }
 
 // Get display dimensions
 void getDisplayDimensions(int *width, int *height) {
-    switch(flashData[21]) {
-        case DISPLAY_SSD1306:
-            *width = SSD1306_LCDWIDTH;
-            *height = SSD1306_LCDHEIGHT;
-            break;
-        case DISPLAY_SSD1331:
-            *width = OLED_W;  // 96
-            *height = OLED_H; // 64
-            break;
-        case DISPLAY_SSD1309:
-            *width = SSD1309_LCDWIDTH;
-            *height = SSD1309_LCDHEIGHT;
-            break;
-        default:
-            *width = 128;
-            *height = 64;
-            break;
-    }
-}
-
-// Find character in font array
-tImage* findChar(uint8_t c) {
-    for (int i = 0; i < Font.length; i++) {
-        if (Font.chars[i].code == c) {
-            return Font.chars[i].image;
-        }
-    }
-    // Return space character if not found
-    for (int i = 0; i < Font.length; i++) {
-        if (Font.chars[i].code == 0x20) { // space character
-            return Font.chars[i].image;
-        }
-    }
-    return NULL;
+    *width = driver->width;
+    *height = driver->height;
 }
 
 // Put a single letter/character on display
 void putLetter(int x, int y, uint8_t letter, uint16_t color) {
-    tImage* char_image = findChar(letter);
-    if (!char_image) return;
-    
-    switch(flashData[21]) {
-        case DISPLAY_SSD1306:
-        case DISPLAY_SSD1309:
-            // For monochrome displays
-            for (int cy = 0; cy < char_image->height; cy++) {
-                for (int cx = 0; cx < char_image->width; cx++) {
-                    int byte_idx = cy;
-                    int bit_idx = cx;
-                    
-                    if (byte_idx < char_image->dataSize) {
-                        uint8_t pixel_data = char_image->data[byte_idx];
-                        bool pixel_on = (pixel_data & (1 << bit_idx)) != 0;
-                        
-                        if (pixel_on) {
-                            setDisplayPixel(x + cx, y + cy, true);
-                        }
-                    }
-                }
-            }
-            break;
-            
-        case DISPLAY_SSD1331:
-            // For color display (SSD1331)
-            for (int cy = 0; cy < char_image->height; cy++) {
-                for (int cx = 0; cx < char_image->width; cx++) {
-                    int byte_idx = cy;
-                    int bit_idx = cx;
-                    
-                    if (byte_idx < char_image->dataSize) {
-                        uint8_t pixel_data = char_image->data[byte_idx];
-                        bool pixel_on = (pixel_data & (1 << bit_idx)) != 0;
-                        
-                        if (pixel_on) {
-                            setPixelSSD1331(x + cx, y + cy, color);
-                        }
-                    }
-                }
-            }
-            break;
-    }
+    driver->put_glyph(x, y, letter, color);
 }
 
 // Put a string on display
@@ -233,6 +263,7 @@ void putString(char* str, int x, int y, uint16_t color) {
     
     int current_x = x;
     int char_spacing = 7; // Adjust based on your font width + spacing
+    int display_width = driver->width;
     
     for (int i = 0; str[i] != '\0'; i++) {
         if (str[i] == '\n') {
@@ -246,10 +277,6 @@ void putString(char* str, int x, int y, uint16_t color) {
         current_x += char_spacing;
         
         // Word wrap if needed (optional)
-        int display_width;
-        int display_height;
-        getDisplayDimensions(&display_width, &display_height);
-        
         if (current_x >= display_width - char_spacing) {
             current_x = x;
             y += 12;
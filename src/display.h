@@ -14,6 +14,69 @@
 // OLED detection pin
 #define OLED_PIN 12
 
+// Panel driver, picked once by displayInit(). Drawing goes straight to the driver's own
+// span and blit loops instead of a dispatch per pixel. Colors are RGB565, monochrome panels
+// light any non-zero color. Everything is clipped to the panel
+typedef struct {
+    const char *name;
+    int width;
+    int height;
+    bool color;
+    void (*init)(void);
+    void (*update)(void);
+    void (*clear)(void);
+    void (*splash)(void);
+    void (*set_pixel)(int x, int y, uint16_t color);
+    void (*fill_rect)(int x, int y, int w, int h, uint16_t color);
+    // Set bits are drawn in color, clear ones left alone. Rows are stride bytes apart, bit 0
+    // of the first byte is the leftmost pixel
+    void (*blit_1bpp)(int x, int y, int w, int h, const uint8_t *bits, int stride, uint16_t color);
+    void (*blit_rgb565)(int x, int y, int w, int h, const uint16_t *pixels);
+    // One character from the font atlas, ink only
+    void (*put_glyph)(int x, int y, uint8_t c, uint16_t color);
+} display_driver_t;
+
+// Cuts a w x h rectangle at (x, y) down to a width x height panel. sx/sy say how much came
+// off the left/top, for the source. False if nothing is left
+static inline bool displayClip(int width, int height, int *x, int *y, int *w, int *h, int *sx, int *sy) {
+    *sx = *x < 0 ? -*x : 0;
+    *sy = *y < 0 ? -*y : 0;
+    *x += *sx;
+    *y += *sy;
+    *w -= *sx;
+    *h -= *sy;
+    if (*x + *w > width) *w = width - *x;
+    if (*y + *h > height) *h = height - *y;
+    return *w > 0 && *h > 0;
+}
+
+// Dirty tracking shared by the panel drivers. Drawing marks what it touched, per band of 8
+// rows (a page on the monochrome panels); an update sends each dirty band as one window,
+// trimmed to the columns that differ from what the panel was last sent
+#define DISPLAY_BAND_ROWS 8
+#define DISPLAY_BANDS 8 // 64 rows on every panel
+
+void displayMarkDirty(int x0, int y0, int x1, int y1);
+void displayMarkAllDirty(void);
+
+// Column range of a band drawn to since the last take, false if it is clean
+bool displayTakeDirtyBand(int band, int *x0, int *x1);
+
+// Narrows [x0, x1] to the columns where now differs from shown: rows lines stride bytes apart,
+// bytes_per_column bytes per column. False if the whole range matches
+bool displayTrimSpan(const uint8_t *now, const uint8_t *shown, int stride, int rows,
+                     int bytes_per_column, int *x0, int *x1);
+
+// Monochrome page-layout drawing behind the SSD1306/SSD1309 driver entry points: fb is
+// width x height, pages of 8 rows, a byte per column, bit 0 on top. Same clipping and
+// dirty marking as display_driver_t
+void displayMonoFillRect(uint8_t *fb, int width, int height, int x, int y, int w, int h, uint16_t color);
+void displayMonoBlit1bpp(uint8_t *fb, int width, int height, int x, int y, int w, int h,
+                         const uint8_t *bits, int stride, uint16_t color);
+void displayMonoBlitRGB565(uint8_t *fb, int width, int height, int x, int y, int w, int h,
+                           const uint16_t *pixels);
+void displayMonoPutGlyph(uint8_t *fb, int width, int height, int x, int y, uint8_t c, uint16_t color);
+
 // Function prototypes
 void displayInit(void);
 void updateDisplay(void);
@@ -27,4 +90,10 @@ uint8_t detect_oled_type(void);
 
 // Your existing display functions (from your current codebase)
 void putLetter(int x, int y, uint8_t letter, uint16_t color);
+
+// Direct driver drawing (see display_driver_t)
+const display_driver_t *displayDriver(void);
+void displayFillRect(int x, int y, int w, int h, uint16_t color);
+void displayBlit1bpp(int x, int y, int w, int h, const uint8_t *bits, int stride, uint16_t color);
+void displayBlitRGB565(int x, int y, int w, int h, const uint16_t *pixels);
 void putString(char* str, int x, int y, uint16_t color);
\ No newline at end of file
@@ -0,0 +1,66 @@
+/*
+ * Core 0 event flags
+ * Dreamcast controller emulator for Raspberry Pi Pico (RP2040/RP2350)
+ *
+ * One byte per event rather than a bitmask, so posting is a plain store from an
+ * interrupt or from core 1 with no read-modify-write (the M0+ has no exclusive
+ * access to do that atomically). Every post is followed by SEV, and SEVONPEND
+ * makes any interrupt going pending (the USB controller's included) an event too,
+ * so a post that lands between the last check and the WFE still wakes us.
+ */
+
+#include "events.h"
+#include "tusb.h"
+#include "trace.h"
+#include "hardware/sync.h"
+#include "hardware/structs/scb.h"
+
+static volatile uint8_t pending[EVENT_COUNT];
+
+void events_init(void) {
+    for (int i = 0; i < EVENT_COUNT; i++) {
+        pending[i] = 0;
+    }
+#if PICO_RP2350
+    scb_hw->scr |= M33_SCR_SEVONPEND_BITS;
+#else
+    scb_hw->scr |= M0PLUS_SCR_SEVONPEND_BITS;
+#endif
+}
+
+void __not_in_flash_func(events_post)(event_id_t id) {
+    pending[id] = 1;
+    __dmb();
+    __sev();
+}
+
+bool events_take(event_id_t id) {
+    if (!pending[id]) {
+        return false;
+    }
+    // Clear before the handler runs, a post during it is kept for the next pass
+    pending[id] = 0;
+    __dmb();
+    return true;
+}
+
+void events_wait(void) {
+    while (true) {
+        // The USB interrupt handler only queues work for tuh_task(), ask the stack directly
+        if (tuh_task_event_ready()) {
+            pending[EVENT_USB] = 1;
+        }
+        for (int i = 0; i < EVENT_COUNT; i++) {
+            if (pending[i]) {
+                return;
+            }
+        }
+        // Trace records go out while there is nothing else to do. If the UART can't take
+        // them all, look again once it has had time to send a frame
+        if (trace_idle()) {
+            best_effort_wfe_or_timeout(make_timeout_time_us(TRACE_FRAME_US));
+        } else {
+            __wfe();
+        }
+    }
+}
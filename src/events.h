@@ -0,0 +1,32 @@
+// FILE: src/events.h
+// Core 0 event flags - interrupts and core 1 post, the main loop sleeps until one is set
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "pico/stdlib.h"
+
+typedef enum {
+    EVENT_USB = 0,        // TinyUSB has queued work (report, mount, unmount)
+    EVENT_MAPLE,          // Core 1 pushed something onto the Maple event queue
+    EVENT_PAGE_BUTTON,    // PAGE_BUTTON changed level
+    EVENT_DISPLAY,        // Status screen refresh is due
+    EVENT_VMU_SAVE,       // VMU went quiet after a write, time to back it up
+    EVENT_FLASH_WRITEBACK,// Core 1 just answered a poll, one dirty VMU block can go to flash
+    EVENT_SD,             // SD block DMA finished or the card is due another look (sd_task)
+    EVENT_LCD,            // Core 1 published a VMU screen frame
+    EVENT_RUMBLE,         // New Puru Puru condition, or the rumble envelope is due a step
+    EVENT_COUNT
+} event_id_t;
+
+void events_init(void);
+
+// Safe from interrupts and from either core
+void events_post(event_id_t id);
+
+// Returns true (and clears it) if the event was posted since the last take
+bool events_take(event_id_t id);
+
+// Sleeps (WFE) until at least one event is pending
+void events_wait(void);
@@ -0,0 +1,450 @@
+/*
+ * FAT32 on the SD card
+ * Dreamcast controller emulator for Raspberry Pi Pico (RP2040/RP2350)
+ *
+ * Just enough for VMU images: files in the root directory, found by 8.3 name.
+ * New files get one contiguous run of clusters, so a 128KB page is a single
+ * multi-block transfer. Files copied on from a PC may be fragmented; their
+ * chain is turned into a few extents on open and the FAT isn't read again.
+ *
+ * Boot, FAT and directory sectors go through sd_cache; FAT changes are made
+ * to every FAT copy and reach the card on the flush at the end of a create.
+ * Long file names are skipped, not created.
+ */
+
+#include <string.h>
+#include <ctype.h>
+#include "fat32.h"
+#include "sdcard.h"
+#include "sd_cache.h"
+
+#define FAT32_EOC 0x0FFFFFF8      // End of chain is anything from here up
+#define FAT32_EOC_MARK 0x0FFFFFFF
+#define FAT32_CLUSTER_MASK 0x0FFFFFFF
+
+#define DIR_ENTRY_SIZE 32
+#define DIR_ENTRIES_PER_SECTOR (FAT32_SECTOR_SIZE / DIR_ENTRY_SIZE)
+#define DIR_ATTR_LFN 0x0F
+#define DIR_ATTR_VOLUME_ID 0x08
+#define DIR_ATTR_DIRECTORY 0x10
+#define DIR_ATTR_ARCHIVE 0x20
+#define DIR_DELETED 0xE5
+
+static inline uint16_t le16(const uint8_t *p) { return p[0] | (p[1] << 8); }
+static inline uint32_t le32(const uint8_t *p) { return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24); }
+static inline void put_le16(uint8_t *p, uint16_t v) { p[0] = v; p[1] = v >> 8; }
+static inline void put_le32(uint8_t *p, uint32_t v) { p[0] = v; p[1] = v >> 8; p[2] = v >> 16; p[3] = v >> 24; }
+
+// Volume geometry
+static bool mounted = false;
+static uint32_t fat_lba;
+static uint32_t fat_sectors;
+static uint8_t num_fats;
+static uint32_t data_lba;
+static uint8_t sectors_per_cluster;
+static uint32_t root_cluster;
+static uint32_t cluster_count;
+static uint32_t fsinfo_lba;
+static uint32_t next_free_hint = 2;
+
+static inline uint32_t cluster_lba(uint32_t cluster) {
+    return data_lba + (cluster - 2) * sectors_per_cluster;
+}
+
+static inline uint32_t fat_entry_lba(uint32_t cluster) {
+    return fat_lba + cluster / (FAT32_SECTOR_SIZE / 4);
+}
+
+static inline uint fat_entry_offset(uint32_t cluster) {
+    return (cluster % (FAT32_SECTOR_SIZE / 4)) * 4;
+}
+
+// FAT32_BAD_READ on error (never a cluster to follow, and never free)
+#define FAT32_BAD_READ 0xFFFFFFFF
+
+static uint32_t fat_get(uint32_t cluster) {
+    const uint8_t *sector = sd_cache_read(fat_entry_lba(cluster));
+    if (!sector) {
+        return FAT32_BAD_READ;
+    }
+    return le32(&sector[fat_entry_offset(cluster)]) & FAT32_CLUSTER_MASK;
+}
+
+static bool fat_set(uint32_t cluster, uint32_t value) {
+    // Every copy, so scandisk and friends stay happy
+    for (uint i = 0; i < num_fats; i++) {
+        uint8_t *sector = sd_cache_modify(fat_entry_lba(cluster) + i * fat_sectors);
+        if (!sector) {
+            return false;
+        }
+        uint8_t *entry = &sector[fat_entry_offset(cluster)];
+        // Top 4 bits are reserved and must be kept
+        put_le32(entry, (le32(entry) & ~FAT32_CLUSTER_MASK) | (value & FAT32_CLUSTER_MASK));
+    }
+    return true;
+}
+
+// "vmu_p1.bin" -> "VMU_P1  BIN"
+static bool make_short_name(const char *name, uint8_t out[11]) {
+    memset(out, ' ', 11);
+    uint i = 0;
+    while (*name && *name != '.') {
+        if (i >= 8) return false;
+        out[i++] = toupper((unsigned char)*name++);
+    }
+    if (*name == '.') {
+        name++;
+        i = 8;
+        while (*name) {
+            if (i >= 11) return false;
+            out[i++] = toupper((unsigned char)*name++);
+        }
+    }
+    return out[0] != ' ';
+}
+
+bool fat32_mount(void) {
+    mounted = false;
+    sd_cache_init();
+
+    const uint8_t *sector = sd_cache_read(0);
+    if (!sector) {
+        printf("FAT32: Can't read sector 0\n");
+        return false;
+    }
+    if (sector[510] != 0x55 || sector[511] != 0xAA) {
+        printf("FAT32: No boot signature\n");
+        return false;
+    }
+
+    // MBR with a FAT32 first partition, or a volume without a partition table
+    uint32_t volume_lba = 0;
+    uint8_t type = sector[0x1C2];
+    if (type == 0x0B || type == 0x0C) {
+        volume_lba = le32(&sector[0x1C6]);
+        sector = sd_cache_read(volume_lba);
+        if (!sector || sector[510] != 0x55 || sector[511] != 0xAA) {
+            printf("FAT32: Bad boot sector in partition 1\n");
+            return false;
+        }
+    }
+
+    uint16_t bytes_per_sector = le16(&sector[0x0B]);
+    uint16_t reserved = le16(&sector[0x0E]);
+    uint32_t total_sectors = le16(&sector[0x13]) ? le16(&sector[0x13]) : le32(&sector[0x20]);
+    sectors_per_cluster = sector[0x0D];
+    num_fats = sector[0x10];
+    fat_sectors = le32(&sector[0x24]);
+    root_cluster = le32(&sector[0x2C]);
+
+    // FAT12/16 have a 16-bit FAT size and a fixed root directory
+    if (bytes_per_sector != FAT32_SECTOR_SIZE || le16(&sector[0x16]) != 0 || fat_sectors == 0 ||
+        sectors_per_cluster == 0 || num_fats == 0) {
+        printf("FAT32: Not a FAT32 volume\n");
+        return false;
+    }
+
+    fat_lba = volume_lba + reserved;
+    data_lba = fat_lba + num_fats * fat_sectors;
+    cluster_count = (total_sectors - (data_lba - volume_lba)) / sectors_per_cluster;
+    fsinfo_lba = volume_lba + le16(&sector[0x30]);
+
+    // Where the last allocation ended, so a new file doesn't have to scan the whole FAT
+    next_free_hint = 2;
+    sector = sd_cache_read(fsinfo_lba);
+    if (sector && le32(&sector[0]) == 0x41615252) {
+        uint32_t hint = le32(&sector[0x1EC]);
+        if (hint >= 2 && hint < cluster_count + 2) {
+            next_free_hint = hint;
+        }
+    }
+
+    mounted = true;
+    printf("FAT32: Mounted, %u clusters of %u sectors\n", cluster_count, sectors_per_cluster);
+    return true;
+}
+
+bool fat32_is_mounted(void) {
+    return mounted;
+}
+
+// Walks the chain once into extents
+static bool load_extents(fat32_file_t *file) {
+    file->num_extents = 0;
+    uint32_t cluster = file->first_cluster;
+    uint32_t clusters = (file->size + sectors_per_cluster * FAT32_SECTOR_SIZE - 1) / (sectors_per_cluster * FAT32_SECTOR_SIZE);
+
+    for (uint32_t n = 0; n < clusters; n++) {
+        if (cluster < 2 || cluster >= cluster_count + 2) {
+            printf("FAT32: Broken cluster chain\n");
+            return false;
+        }
+
+        fat32_extent_t *last = file->num_extents ? &file->extents[file->num_extents - 1] : NULL;
+        if (last && last->lba + last->sectors == cluster_lba(cluster)) {
+            last->sectors += sectors_per_cluster;
+        } else {
+            if (file->num_extents == FAT32_MAX_EXTENTS) {
+                printf("FAT32: File too fragmented\n");
+                return false;
+            }
+            file->extents[file->num_extents].lba = cluster_lba(cluster);
+            file->extents[file->num_extents].sectors = sectors_per_cluster;
+            file->num_extents++;
+        }
+
+        if (n + 1 < clusters) {
+            cluster = fat_get(cluster);
+        }
+    }
+    return true;
+}
+
+typedef bool (*dir_visit_t)(const uint8_t *entry, uint32_t lba, uint index, void *context);
+
+// Calls visit for every root directory entry until it returns true
+static bool scan_root(dir_visit_t visit, void *context) {
+    uint32_t cluster = root_cluster;
+    while (cluster >= 2 && cluster < FAT32_EOC) {
+        for (uint s = 0; s < sectors_per_cluster; s++) {
+            uint32_t lba = cluster_lba(cluster) + s;
+            const uint8_t *sector = sd_cache_read(lba);
+            if (!sector) {
+                return false;
+            }
+            for (uint i = 0; i < DIR_ENTRIES_PER_SECTOR; i++) {
+                if (visit(&sector[i * DIR_ENTRY_SIZE], lba, i, context)) {
+                    return true;
+                }
+            }
+        }
+        cluster = fat_get(cluster);
+    }
+    return false;
+}
+
+typedef struct {
+    uint8_t name[11];
+    fat32_file_t *file;
+    bool found;
+    bool end;        // Hit the end-of-directory marker
+    uint32_t free_lba;
+    int free_index;
+} dir_search_t;
+
+static bool find_entry(const uint8_t *entry, uint32_t lba, uint index, void *context) {
+    dir_search_t *search = (dir_search_t *)context;
+
+    if (entry[0] == 0x00 || entry[0] == DIR_DELETED) {
+        if (search->free_index < 0) {
+            search->free_lba = lba;
+            search->free_index = index;
+        }
+        if (entry[0] == 0x00) {
+            search->end = true;
+            return true;
+        }
+        return false;
+    }
+    if ((entry[11] & DIR_ATTR_LFN) == DIR_ATTR_LFN || (entry[11] & (DIR_ATTR_VOLUME_ID | DIR_ATTR_DIRECTORY))) {
+        return false;
+    }
+    if (memcmp(entry, search->name, 11) != 0) {
+        return false;
+    }
+
+    search->file->first_cluster = (le16(&entry[20]) << 16) | le16(&entry[26]);
+    search->file->size = le32(&entry[28]);
+    search->found = true;
+    return true;
+}
+
+static bool search_root(const char *name, fat32_file_t *file, dir_search_t *search) {
+    memset(search, 0, sizeof(*search));
+    search->file = file;
+    search->free_index = -1;
+    if (!mounted || !make_short_name(name, search->name)) {
+        return false;
+    }
+    scan_root(find_entry, search);
+    return true;
+}
+
+bool fat32_open(const char *name, fat32_file_t *file) {
+    dir_search_t search;
+    if (!search_root(name, file, &search) || !search.found) {
+        return false;
+    }
+    return load_extents(file);
+}
+
+// First run of count free clusters, from the FSInfo hint and wrapping around. 0 if none
+static uint32_t find_free_run(uint32_t count) {
+    uint32_t run_start = 0;
+    uint32_t run_length = 0;
+    uint32_t cluster = next_free_hint;
+
+    for (uint32_t n = 0; n < cluster_count; n++, cluster++) {
+        if (cluster >= cluster_count + 2) {
+            // Runs don't wrap
+            cluster = 2;
+            run_length = 0;
+        }
+        uint32_t entry = fat_get(cluster);
+        if (entry == FAT32_BAD_READ) {
+            return 0;
+        }
+        if (entry != 0) {
+            run_length = 0;
+            continue;
+        }
+        if (run_length++ == 0) {
+            run_start = cluster;
+        }
+        if (run_length == count) {
+            return run_start;
+        }
+    }
+    return 0;
+}
+
+// Free count is left to the next fsck, next free moves past what was just taken
+static void update_fsinfo(void) {
+    uint8_t *sector = sd_cache_modify(fsinfo_lba);
+    if (sector && le32(&sector[0]) == 0x41615252) {
+        put_le32(&sector[0x1E8], 0xFFFFFFFF);
+        put_le32(&sector[0x1EC], next_free_hint);
+    }
+}
+
+bool fat32_create(const char *name, uint32_t size, fat32_file_t *file) {
+    dir_search_t search;
+    if (!search_root(name, file, &search)) {
+        return false;
+    }
+    if (search.found) {
+        if (file->size < size) {
+            printf("FAT32: %s is smaller than %u bytes\n", name, size);
+            return false;
+        }
+        return load_extents(file);
+    }
+    if (search.free_index < 0) {
+        printf("FAT32: Root directory full\n");
+        return false;
+    }
+
+    uint32_t cluster_bytes = sectors_per_cluster * FAT32_SECTOR_SIZE;
+    uint32_t clusters = (size + cluster_bytes - 1) / cluster_bytes;
+    uint32_t first = find_free_run(clusters);
+    if (first == 0) {
+        printf("FAT32: No room for %s\n", name);
+        return false;
+    }
+
+    // Chain first, then the directory entry that points at it
+    for (uint32_t i = 0; i < clusters; i++) {
+        if (!fat_set(first + i, i + 1 < clusters ? first + i + 1 : FAT32_EOC_MARK)) {
+            return false;
+        }
+    }
+    next_free_hint = first + clusters;
+    if (next_free_hint >= cluster_count + 2) next_free_hint = 2;
+
+    uint8_t *sector = sd_cache_modify(search.free_lba);
+    if (!sector) {
+        return false;
+    }
+    uint8_t *entry = &sector[search.free_index * DIR_ENTRY_SIZE];
+    memset(entry, 0, DIR_ENTRY_SIZE);
+    memcpy(entry, search.name, 11);
+    entry[11] = DIR_ATTR_ARCHIVE;
+    // Created, accessed and modified 2025-01-01 00:00, there is no RTC
+    uint16_t date = (45 << 9) | (1 << 5) | 1;
+    put_le16(&entry[16], date);
+    put_le16(&entry[18], date);
+    put_le16(&entry[24], date);
+    put_le16(&entry[20], first >> 16);
+    put_le16(&entry[26], first & 0xFFFF);
+    put_le32(&entry[28], size);
+    update_fsinfo();
+
+    // FAT copies, directory and FSInfo, neighbouring sectors in one write
+    if (!sd_cache_flush()) {
+        return false;
+    }
+
+    printf("FAT32: Created %s, %u clusters at %u\n", name, clusters, first);
+    file->first_cluster = first;
+    file->size = size;
+    file->num_extents = 1;
+    file->extents[0].lba = cluster_lba(first);
+    file->extents[0].sectors = clusters * sectors_per_cluster;
+    return true;
+}
+
+uint32_t fat32_sector_lba(const fat32_file_t *file, uint32_t sector) {
+    for (uint i = 0; i < file->num_extents; i++) {
+        if (sector < file->extents[i].sectors) {
+            return file->extents[i].lba + sector;
+        }
+        sector -= file->extents[i].sectors;
+    }
+    return 0;
+}
+
+typedef bool (*transfer_t)(uint32_t lba, uint32_t count, uint8_t *buffer);
+
+static bool read_run(uint32_t lba, uint32_t count, uint8_t *buffer) {
+    return sd_cache_read_blocks(lba, count, buffer);
+}
+
+static bool write_run(uint32_t lba, uint32_t count, uint8_t *buffer) {
+    return sd_cache_write_blocks(lba, count, buffer);
+}
+
+// Splits the range at extent boundaries, one multi-block transfer per piece
+static bool transfer(const fat32_file_t *file, uint32_t sector, uint32_t count, uint8_t *buffer, transfer_t run) {
+    for (uint i = 0; i < file->num_extents && count; i++) {
+        const fat32_extent_t *extent = &file->extents[i];
+        if (sector >= extent->sectors) {
+            sector -= extent->sectors;
+            continue;
+        }
+        uint32_t n = extent->sectors - sector;
+        if (n > count) n = count;
+        if (!run(extent->lba + sector, n, buffer)) {
+            return false;
+        }
+        buffer += n * FAT32_SECTOR_SIZE;
+        count -= n;
+        sector = 0;
+    }
+    return count == 0;
+}
+
+bool fat32_read(const fat32_file_t *file, uint32_t sector, uint32_t count, uint8_t *buffer) {
+    return mounted && transfer(file, sector, count, buffer, read_run);
+}
+
+bool fat32_write(const fat32_file_t *file, uint32_t sector, uint32_t count, const uint8_t *buffer) {
+    return mounted && transfer(file, sector, count, (uint8_t *)buffer, write_run);
+}
+
+bool fat32_submit_write(const fat32_file_t *file, uint32_t sector, uint32_t count, const uint8_t *buffer,
+                        sd_callback_t callback, void *context) {
+    if (!mounted || count == 0) {
+        return false;
+    }
+    for (uint i = 0; i < file->num_extents; i++) {
+        const fat32_extent_t *extent = &file->extents[i];
+        if (sector < extent->sectors) {
+            if (count > extent->sectors - sector) {
+                return false;
+            }
+            return sd_cache_submit_write_blocks(extent->lba + sector, count, buffer, callback, context);
+        }
+        sector -= extent->sectors;
+    }
+    return false;
+}
@@ -0,0 +1,49 @@
+// FILE: src/fat32.h
+// Minimal FAT32 on the SD card: root directory 8.3 files, contiguous preallocation
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "pico/stdlib.h"
+#include "sdcard.h"
+
+#define FAT32_SECTOR_SIZE 512
+#define FAT32_MAX_EXTENTS 8 // Runs of consecutive sectors a file may be split into
+
+typedef struct {
+    uint32_t lba;
+    uint32_t sectors;
+} fat32_extent_t;
+
+// An open file. The cluster chain is walked once on open and kept as extents, so reads and
+// writes never touch the FAT again and each extent is one multi-block transfer
+typedef struct {
+    uint32_t first_cluster;
+    uint32_t size;                             // Bytes
+    uint8_t num_extents;
+    fat32_extent_t extents[FAT32_MAX_EXTENTS];
+} fat32_file_t;
+
+// Finds the FAT32 volume (partition 1 of an MBR, or a superfloppy). False if there is none
+bool fat32_mount(void);
+bool fat32_is_mounted(void);
+
+// name is "NAME.EXT" in the root directory (8.3, case-insensitive)
+bool fat32_open(const char *name, fat32_file_t *file);
+
+// Opens name, creating it with size bytes in contiguous clusters if it doesn't exist.
+// Fails if an existing file is smaller than size (it is never grown)
+bool fat32_create(const char *name, uint32_t size, fat32_file_t *file);
+
+// Card block holding a file sector, 0 if it is past the allocation (block 0 is never file data)
+uint32_t fat32_sector_lba(const fat32_file_t *file, uint32_t sector);
+
+// Whole sectors from sector (file relative) on, within the file's allocation
+bool fat32_read(const fat32_file_t *file, uint32_t sector, uint32_t count, uint8_t *buffer);
+bool fat32_write(const fat32_file_t *file, uint32_t sector, uint32_t count, const uint8_t *buffer);
+
+// fat32_write() as a background request, for a range within one extent. False if the range
+// is split (write it with fat32_write) or the card is busy
+bool fat32_submit_write(const fat32_file_t *file, uint32_t sector, uint32_t count, const uint8_t *buffer,
+                        sd_callback_t callback, void *context);
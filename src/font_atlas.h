@@ -0,0 +1,25 @@
+// FILE: src/font_atlas.h
+// Glyphs indexed by character, in each panel's own layout. font_atlas.c is generated at build
+// time from font.c by tools/font_atlas.py
+
+#pragma once
+
+#include <stdint.h>
+#include "pico/stdlib.h"
+
+#define FONT_FIRST_CHAR 0x20
+#define FONT_LAST_CHAR 0x7E
+#define FONT_GLYPHS (FONT_LAST_CHAR - FONT_FIRST_CHAR + 1)
+#define FONT_WIDTH 6
+#define FONT_HEIGHT 10
+
+// Monochrome panels: a word per column, bit r lit for row r
+extern const uint16_t fontColumns[FONT_GLYPHS][FONT_WIDTH];
+
+// RGB565 panels: 0xFFFF where lit, 0 elsewhere, FONT_HEIGHT rows of FONT_WIDTH
+extern const uint16_t fontMasks[FONT_GLYPHS][FONT_HEIGHT * FONT_WIDTH];
+
+// Anything outside the table draws as a space
+static inline uint fontIndex(uint8_t c) {
+    return (uint)(c - FONT_FIRST_CHAR) < FONT_GLYPHS ? c - FONT_FIRST_CHAR : 0;
+}
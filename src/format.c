@@ -224,7 +224,7 @@ uint32_t pagePalette[] = {
   0xf6abe596
 };
 
-uint32_t CheckFormatted(uint8_t *MemoryCard, uint32_t CurrentPage)
+uint32_t CheckFormatted(ReadBlockFunc ReadBlock, WriteBlockFunc WriteBlock, uint32_t CurrentPage)
 {
 	uint32_t SectorDirty = 0;
 	const RootBlock Root =
@@ -233,19 +233,25 @@ uint32_t CheckFormatted(uint8_t *MemoryCard, uint32_t CurrentPage)
 			1, pagePalette[CurrentPage - 1] >> 8 & 0xFF,	pagePalette[CurrentPage - 1] >> 16 & 0xFF, pagePalette[CurrentPage - 1] >> 24 & 0xFF, pagePalette[CurrentPage - 1] & 0xFF, {0}, {0x20, 0x21, 0x03, 0x02, 0x09, 0x00, 0x00, 0x01}, {0}, CARD_BLOCKS - 1,
 			0, ROOT_BLOCK, FAT_BLOCK, NUM_FAT_BLOCKS, DIRECTORY_BLOCK, NUM_DIRECTORY_BLOCKS, 0,	SAVE_BLOCK,	NUM_SAVE_BLOCKS, 0x800000};
 
-	if (memcmp(&MemoryCard[ROOT_BLOCK * BLOCK_SIZE], Root.Magic, sizeof(Root.Magic)) != 0)
+	if (memcmp(ReadBlock(ROOT_BLOCK), Root.Magic, sizeof(Root.Magic)) != 0)
 	{
 		// If not formatted then initialize ourselves. Saves user a step + means we can have a fancy icon
 		uint32_t StartOfDirectoryBlock = Root.DirectoryBlock - Root.DirectorySizeInBlocks + 1;
-		memset(&MemoryCard[StartOfDirectoryBlock * BLOCK_SIZE], 0, (256 - StartOfDirectoryBlock) * BLOCK_SIZE);
-		memcpy(&MemoryCard[ROOT_BLOCK * BLOCK_SIZE], &Root, sizeof(Root));
+		for (uint32_t Block = StartOfDirectoryBlock; Block < CARD_BLOCKS; Block++)
+		{
+			memset(WriteBlock(Block), 0, BLOCK_SIZE);
+		}
+		memcpy(WriteBlock(ROOT_BLOCK), &Root, sizeof(Root));
 
 		const DirectoryEntry IconDataVMS = {FileType_Data, 0, SAVE_BLOCK - 2, "ICONDATA_VMS", {0x20, 0x21, 0x03, 0x02, 0x09, 0x00, 0x00, 0x01}, 2, 0};
-		memcpy(&MemoryCard[Root.DirectoryBlock * BLOCK_SIZE], &IconDataVMS, sizeof(IconDataVMS));
-		memcpy(&MemoryCard[IconDataVMS.FirstBlock * BLOCK_SIZE], &IconData, sizeof(IconData));
+		memcpy(WriteBlock(Root.DirectoryBlock), &IconDataVMS, sizeof(IconDataVMS));
+		// Icon spans two blocks
+		memcpy(WriteBlock(IconDataVMS.FirstBlock), &IconData[0], BLOCK_SIZE);
+		memcpy(WriteBlock(IconDataVMS.FirstBlock + 1), &IconData[BLOCK_SIZE], sizeof(IconData) - BLOCK_SIZE);
 
+		// Single FAT block (NUM_FAT_BLOCKS)
 		uint32_t StartOfFATBlock = Root.FATBlock - Root.FATSizeInBlocks + 1;
-		uint16_t *FAT = (uint16_t *)&MemoryCard[StartOfFATBlock * BLOCK_SIZE];
+		uint16_t *FAT = (uint16_t *)WriteBlock(StartOfFATBlock);
 		for (uint32_t Block = 0; Block < Root.FATSizeInBlocks * (BLOCK_SIZE / sizeof(uint16_t)); Block++)
 		{
 			FAT[Block] = FATType_Free;
@@ -263,4 +269,4 @@ uint32_t CheckFormatted(uint8_t *MemoryCard, uint32_t CurrentPage)
 #endif
 	}
 	return SectorDirty;
-}
\ No newline at end of file
+}
@@ -13,7 +13,15 @@ extern "C" {
 
 #define BLOCK_SIZE 512
 
-uint32_t CheckFormatted(uint8_t *MemoryCard, uint32_t CurrentPage);
+// Block accessors so the card doesn't have to be one flat buffer. WriteBlock returns the
+// block to modify (and marks it for writing back), ReadBlock is for looking only
+typedef const uint8_t *(*ReadBlockFunc)(uint32_t Block);
+typedef uint8_t *(*WriteBlockFunc)(uint32_t Block);
+
+// Per-page color, RGBA with red in the top byte. Page n uses entry (n - 1) % 8
+extern uint32_t pagePalette[];
+
+uint32_t CheckFormatted(ReadBlockFunc ReadBlock, WriteBlockFunc WriteBlock, uint32_t CurrentPage);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,199 @@
+/*
+ * Input latency accounting
+ * Dreamcast controller emulator for Raspberry Pi Pico (RP2040/RP2350)
+ *
+ * The USB report time travels with the controller snapshot to core 1. The
+ * first GetCondition reply after the snapshot is applied is when that input
+ * reaches the Dreamcast, so report-to-reply age is measured once per report.
+ * A report replaced before any poll never reached the Dreamcast and is not
+ * counted. The age includes waiting for the next poll, about one frame at
+ * worst, which is what a player actually feels.
+ *
+ * Every histogram has a single writer: core 1 for the Maple side, core 0
+ * for mapping. Core 0 reads them without stopping anyone, summarises them
+ * every LATENCY_WINDOW_MS and asks the writer to start over. The writer
+ * clears its histogram itself, on its next sample, so core 0 never stores
+ * into it.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "latency.h"
+#include "maple.h"
+#include "display.h"
+#include "ram_copy.h"
+
+typedef struct {
+    uint32_t counts[LATENCY_BUCKETS];
+    uint32_t samples;
+    uint32_t max_us;
+    volatile bool reset;   // Set by core 0, cleared by the writer along with the counts
+} latency_histogram_t;
+
+static latency_histogram_t histograms[LATENCY_COUNT];
+static latency_summary_t summaries[LATENCY_COUNT];
+static absolute_time_t window_end;
+
+static const char *const metric_names[LATENCY_COUNT] = {
+    "report to reply",
+    "poll to reply",
+    "report to mapped",
+};
+
+// Core 1 only
+static uint32_t pending_report_us;
+static bool report_pending = false;
+
+static __force_inline uint latency_bucket(uint32_t us) {
+    if (us < LATENCY_LINEAR) {
+        return us;
+    }
+    if (us > LATENCY_MAX_US) {
+        us = LATENCY_MAX_US;
+    }
+    uint exponent = 31 - __builtin_clz(us); // 4 and up
+    return LATENCY_LINEAR + (exponent - 4) * LATENCY_SUB_BUCKETS +
+           ((us >> (exponent - 3)) & (LATENCY_SUB_BUCKETS - 1));
+}
+
+// Largest value that lands in the bucket
+static uint32_t latency_bucket_limit(uint bucket) {
+    if (bucket < LATENCY_LINEAR) {
+        return bucket;
+    }
+    uint exponent = 4 + (bucket - LATENCY_LINEAR) / LATENCY_SUB_BUCKETS;
+    uint sub = (bucket - LATENCY_LINEAR) % LATENCY_SUB_BUCKETS;
+    return ((LATENCY_SUB_BUCKETS + sub + 1) << (exponent - 3)) - 1;
+}
+
+static void __not_in_flash_func(latency_record)(latency_metric_t metric, uint32_t us) {
+    latency_histogram_t *histogram = &histograms[metric];
+    if (histogram->reset) {
+        ram_zero_words(histogram->counts, sizeof(histogram->counts));
+        histogram->samples = 0;
+        histogram->max_us = 0;
+        __dmb();
+        histogram->reset = false;
+    }
+    histogram->counts[latency_bucket(us)]++;
+    histogram->samples++;
+    if (us > histogram->max_us) {
+        histogram->max_us = us;
+    }
+}
+
+void latency_init(void) {
+    memset(histograms, 0, sizeof(histograms));
+    memset(summaries, 0, sizeof(summaries));
+    window_end = make_timeout_time_ms(LATENCY_WINDOW_MS);
+}
+
+void latency_report_mapped(uint32_t report_us) {
+    latency_record(LATENCY_MAPPING, time_us_32() - report_us);
+}
+
+void __not_in_flash_func(latency_input_applied)(uint32_t report_us) {
+    pending_report_us = report_us;
+    report_pending = true;
+}
+
+void __not_in_flash_func(latency_reply_sent)(uint32_t poll_us, uint32_t reply_us) {
+    latency_record(LATENCY_TURNAROUND, reply_us - poll_us);
+    if (report_pending) {
+        report_pending = false;
+        latency_record(LATENCY_INPUT_AGE, reply_us - pending_report_us);
+    }
+}
+
+// Percentiles from a copy, the writer may be adding to the live counts meanwhile
+static void latency_summarise(latency_metric_t metric, latency_summary_t *summary) {
+    latency_histogram_t *histogram = &histograms[metric];
+    memset(summary, 0, sizeof(*summary));
+    if (histogram->reset) {
+        return; // Nothing since the last window
+    }
+
+    static uint32_t counts[LATENCY_BUCKETS];
+    memcpy(counts, histogram->counts, sizeof(counts));
+    uint32_t total = 0;
+    for (uint i = 0; i < LATENCY_BUCKETS; i++) {
+        total += counts[i];
+    }
+    if (!total) {
+        return;
+    }
+
+    uint32_t max_us = histogram->max_us;
+    uint32_t p50_rank = (total + 1) / 2;
+    uint32_t p99_rank = total - total / 100;
+    uint32_t seen = 0;
+    bool p50_found = false; // 0us is a real median for the short metrics
+    for (uint i = 0; i < LATENCY_BUCKETS; i++) {
+        if (!counts[i]) {
+            continue;
+        }
+        seen += counts[i];
+        uint32_t limit = latency_bucket_limit(i);
+        if (limit > max_us) {
+            limit = max_us;
+        }
+        if (!p50_found && seen >= p50_rank) {
+            summary->p50_us = limit;
+            p50_found = true;
+        }
+        if (seen >= p99_rank) {
+            summary->p99_us = limit;
+            break;
+        }
+    }
+    summary->samples = total;
+    summary->max_us = max_us;
+}
+
+void latency_task(void) {
+    if (!time_reached(window_end)) {
+        return;
+    }
+    window_end = make_timeout_time_ms(LATENCY_WINDOW_MS);
+
+    for (uint i = 0; i < LATENCY_COUNT; i++) {
+        latency_summarise(i, &summaries[i]);
+        histograms[i].reset = true;
+    }
+    if (!summaries[LATENCY_TURNAROUND].samples) {
+        return; // No Dreamcast polling, nothing worth printing
+    }
+    for (uint i = 0; i < LATENCY_COUNT; i++) {
+        const latency_summary_t *summary = &summaries[i];
+        printf("Latency %s: n=%lu p50=%luus p99=%luus max=%luus\n", metric_names[i],
+               (unsigned long)summary->samples, (unsigned long)summary->p50_us,
+               (unsigned long)summary->p99_us, (unsigned long)summary->max_us);
+    }
+}
+
+const latency_summary_t *latency_summary(latency_metric_t metric) {
+    return &summaries[metric];
+}
+
+// Milliseconds with one decimal
+static void latency_format_ms(char *out, const char *label, uint32_t us) {
+    sprintf(out, "%s%3lu.%lums", label, (unsigned long)(us / 1000), (unsigned long)(us % 1000 / 100));
+}
+
+void latency_draw(void) {
+    const latency_summary_t *age = &summaries[LATENCY_INPUT_AGE];
+    const latency_summary_t *turnaround = &summaries[LATENCY_TURNAROUND];
+    char line[24];
+
+    clearDisplay();
+    putString("Input lag", 0, 0, color);
+    latency_format_ms(line, "50%", age->p50_us);
+    putString(line, 0, 12, color);
+    latency_format_ms(line, "99%", age->p99_us);
+    putString(line, 0, 24, color);
+    latency_format_ms(line, "max", age->max_us);
+    putString(line, 0, 36, color);
+    sprintf(line, "Reply %luus", (unsigned long)turnaround->p99_us);
+    putString(line, 0, 48, color);
+    updateDisplay();
+}
@@ -0,0 +1,48 @@
+// FILE: src/latency.h
+// Input latency accounting: USB report to Maple reply, in histograms summarised per window
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "pico/stdlib.h"
+
+#define LATENCY_WINDOW_MS 10000  // Summaries cover this long, printed over serial as each closes
+
+// 8 buckets per power of two (12.5% resolution) up to about a second, exact below 16us
+#define LATENCY_SUB_BUCKETS 8
+#define LATENCY_LINEAR 16
+#define LATENCY_MAX_US ((1u << 20) - 1)
+#define LATENCY_BUCKETS (LATENCY_LINEAR + (20 - 4) * LATENCY_SUB_BUCKETS)
+
+typedef enum {
+    LATENCY_INPUT_AGE = 0, // USB report arrival to the first Maple reply carrying it
+    LATENCY_TURNAROUND,    // GetCondition poll decoded to reply queued on the bus
+    LATENCY_MAPPING,       // USB report arrival to the Dreamcast state being published
+    LATENCY_COUNT
+} latency_metric_t;
+
+typedef struct {
+    uint32_t samples;
+    uint32_t p50_us;       // Bucket upper bounds, so never an underestimate
+    uint32_t p99_us;
+    uint32_t max_us;       // Exact
+} latency_summary_t;
+
+void latency_init(void);
+
+// Core 0, once the report has been mapped and published
+void latency_report_mapped(uint32_t report_us);
+
+// Core 1. A new snapshot went into the GetCondition reply, and a reply went out
+void latency_input_applied(uint32_t report_us);
+void latency_reply_sent(uint32_t poll_us, uint32_t reply_us);
+
+// Core 0, at least once a second. Closes the window when it is due
+void latency_task(void);
+
+// Core 0. Last closed window
+const latency_summary_t *latency_summary(latency_metric_t metric);
+
+// Core 0. Diagnostics screen with the last window's input age and turnaround
+void latency_draw(void);
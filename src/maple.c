@@ -12,6 +12,17 @@
 #include "sdcard.h"
 #include "menu.h"
 #include "xbox360_usb.h"
+#include "maple_bus.h"
+#include "spsc_queue.h"
+#include "events.h"
+#include "vmu_store.h"
+#include "fat32.h"
+#include "vmu_sd.h"
+#include "vmu_lcd.h"
+#include "rumble.h"
+#include "trace.h"
+#include "latency.h"
+#include "ram_copy.h"
 
 // RP2350 primary target with RP2040 backward compatibility
 #ifdef PICO_RP2040
@@ -23,9 +34,11 @@
 #define MAX_FLASH_SIZE (4 * 1024 * 1024) // 4MB flash on RP2350
 #endif
 
+// Settings sector of older firmware first (read once as a fallback), then the VMU log (see vmu_store.c)
+#define VMU_FLASH_OFFSET (FLASH_OFFSET + FLASH_SECTOR_SIZE)
+
 // Maple Bus Defines and Funcs
 #define SHOULD_SEND 1  // Set to zero to sniff two devices sending signals to each other
-#define SHOULD_PRINT 0 // Nice for debugging but can cause timing issues
 
 // HKT-7700 (Standard Controller) or HKT-7300 (Arcade Stick) (see maple.h)
 #if HKT7700
@@ -39,7 +52,10 @@
 
 // Memory Card
 #define PHASE_SIZE (BLOCK_SIZE / 4)
-#define FLASH_WRITE_DELAY 16      // About quarter of a second if polling once a frame
+#define FLASH_WRITE_DELAY 16      // Quiet period before VMU writeback, in controller polls. About quarter of a second if polling once a frame
+#define VMU_SAVE_DELAY_US (FLASH_WRITE_DELAY * 16670) // Same quiet period for the SD backup, measured on core 0
+#define STATUS_REFRESH_MS 1000
+#define DIAG_SCREEN_PERIOD 10     // Status refreshes per status/latency screen cycle, half each
 
 #define ADDRESS_DREAMCAST 0
 #define ADDRESS_CONTROLLER 0x20
@@ -47,16 +63,71 @@
 #define ADDRESS_SUBPERIPHERAL1 0x02
 
 // Global variable definitions
-uint8_t MemoryCard[2048] = {0};     // VMU memory card storage
 uint8_t flashData[64] = {0};        // Flash configuration data, initialized to zero
 uint16_t color = 0xFFFF;            // Display color (white)
 bool sd_card_available = false;
 
 // Maple communication variables
-static PIO maple_tx_pio = pio0;
-static PIO maple_rx_pio = pio1;
-static uint maple_tx_sm = 0;
-static uint maple_rx_sm = 0;
+static uint8_t last_port = 0;      // Port bits (top two address bits) from the last packet sent to us
+
+// Replies. Everything handed to maple_tx_send() as a Body lives in RAM so the TX DMA can read it
+static PacketDeviceInfo ControllerInfo;
+static PacketDeviceInfo VMUInfo;
+static PacketMemoryInfo VMUMemoryInfo;
+static PacketLCDInfo VMULCDInfo;
+#if ENABLE_RUMBLE
+static PacketDeviceInfo PuruPuruInfo;
+static uint PuruPuruMediaInfo[2];   // Func, then the supported frequency range and settings
+static uint PuruPuruCondition;      // Last SetCondition word as sent, for GetCondition
+static uint PuruPuruAutoStop;       // Auto-stop time word, for BlockRead
+#endif
+
+// GetCondition reply kept fully encoded (bit-pair count, header, condition, CRC) so it can
+// be queued the moment a poll is decoded. Two copies: the TX DMA may still be reading the
+// live one while the other is patched, then they swap.
+typedef struct HotCondition_s {
+    uint BitPairsMinus1;
+    PacketHeader Header;
+    PacketControllerCondition Condition;
+    uint CRC;
+} HotCondition;
+
+#define HOT_CONDITION_WORDS (sizeof(HotCondition) / sizeof(uint))
+#define HOT_CONDITION_BUTTONS_WORD 3 // Buttons, right trigger, left trigger
+#define HOT_CONDITION_STICKS_WORD 4  // JoyX, JoyY, JoyX2, JoyY2
+#define HOT_CONDITION_CRC_WORD 5
+
+static HotCondition HotConditions[2] __attribute__((aligned(4)));
+static volatile uint HotIndex = 0;
+
+// Core 1 owns the Maple bus. Controller state reaches it through the snapshot published by
+// xbox360_usb.c, everything else core 0 needs to hear about comes back through this queue
+typedef enum {
+    MAPLE_EVENT_BLOCK_WRITE = 0,   // Dreamcast finished writing a VMU block
+    MAPLE_EVENT_STORE_FULL,        // VMU write pool is full, flush now
+    MAPLE_EVENT_BLOCK_FETCH,       // VMU block on the SD card isn't in RAM, fetch it
+} maple_event_type_t;
+
+typedef struct maple_event_s {
+    uint8_t type;
+    uint8_t unit;
+    uint16_t block;
+} maple_event_t;
+
+#define EVENT_QUEUE_SIZE 32
+
+static maple_event_t event_queue_storage[EVENT_QUEUE_SIZE] __attribute__((aligned(4)));
+static spsc_queue_t event_queue;     // core 1 -> core 0
+
+// Flash writeback timing, counted on core 1 in controller polls
+static volatile uint32_t maple_poll_count = 0;
+static uint polls_since_write = 0;
+
+// Core 0 side of VMU persistence
+static bool vmu_dirty = false;
+static alarm_id_t vmu_save_alarm = 0;
+
+static struct repeating_timer status_timer;
 
 // Controller input source selection
 typedef enum {
@@ -75,8 +146,16 @@ bool save_vmu_to_sd(uint8_t page);
 bool load_vmu_from_sd(uint8_t page);
 void rp2350_optimizations(void);
 void handle_maple_communication(void);
+void launch_maple_core1(void);
+void handle_maple_events(void);
+void handle_vmu_save(void);
+static void page_button_irq(uint gpio, uint32_t events);
 void update_input_source(void);
-void send_dreamcast_controller_data(dreamcast_state_t* state);
+void send_dreamcast_controller_data(void);
+static void BuildInfoPackets(void);
+static void BuildHotCondition(uint8_t Port);
+static void maple_patch_condition(const dreamcast_state_t* state);
+static void ConsumePacket(const uint8_t *Packet, uint Size);
 
 // Flash memory functions
 void readFlash(void) {
@@ -86,20 +165,23 @@ void readFlash(void) {
     const uint8_t *flash_contents = (const uint8_t *)(XIP_BASE + FLASH_OFFSET);
     
     // Verify flash bounds for safety
-    if (FLASH_OFFSET + sizeof(flashData) + sizeof(MemoryCard) > MAX_FLASH_SIZE) {
+    if (VMU_FLASH_OFFSET + VMU_STORE_BYTES > MAX_FLASH_SIZE) {
         printf("Warning: Flash offset exceeds available flash size\n");
         memset(flashData, 0, sizeof(flashData));
-        memset(MemoryCard, 0, sizeof(MemoryCard));
         return;
     }
     
+    // Settings saved by older firmware are in their own sector. Newer ones are in the VMU
+    // log and replace these once it has been scanned (see initialize_peripherals())
     memcpy(flashData, flash_contents, sizeof(flashData));
-    memcpy(MemoryCard, flash_contents + sizeof(flashData), sizeof(MemoryCard));
+    if (vmu_store_load_config(flashData, sizeof(flashData))) {
+        printf("Flash data read successfully from the VMU log\n");
+        return;
+    }
     printf("Flash data read successfully from offset 0x%X\n", FLASH_OFFSET);
     #else
     // Initialize with defaults for non-hardware builds
     memset(flashData, 0, sizeof(flashData));
-    memset(MemoryCard, 0, sizeof(MemoryCard));
     printf("Flash read placeholder - using defaults\n");
     #endif
 }
@@ -107,30 +189,9 @@ void readFlash(void) {
 void updateFlashData(void) {
     // Write flash memory configuration - optimized for RP2350
     #ifdef PICO_HW
-    // Disable interrupts during flash write
-    uint32_t interrupts = save_and_disable_interrupts();
-    
-    // Verify flash bounds
-    if (FLASH_OFFSET + FLASH_SECTOR_SIZE > MAX_FLASH_SIZE) {
-        printf("Error: Flash write would exceed available flash\n");
-        restore_interrupts(interrupts);
-        return;
-    }
-    
-    // Erase flash sector
-    flash_range_erase(FLASH_OFFSET, FLASH_SECTOR_SIZE);
-    
-    // Prepare data to write (RP2350 can handle larger sectors efficiently)
-    uint8_t write_buffer[FLASH_SECTOR_SIZE];
-    memset(write_buffer, 0, FLASH_SECTOR_SIZE);
-    memcpy(write_buffer, flashData, sizeof(flashData));
-    memcpy(write_buffer + sizeof(flashData), MemoryCard, sizeof(MemoryCard));
-    
-    // Write to flash
-    flash_range_program(FLASH_OFFSET, write_buffer, FLASH_SECTOR_SIZE);
-    
-    // Restore interrupts
-    restore_interrupts(interrupts);
+    // Settings are a record in the VMU log, so saving them no longer erases a sector.
+    // Unchanged settings are skipped there
+    vmu_store_save_config(flashData, sizeof(flashData));
     printf("Flash data written successfully to RP2350 flash\n");
     #else
     printf("Flash write placeholder - data saved to memory\n");
@@ -153,15 +214,11 @@ void initialize_maple_bus(void) {
     gpio_pull_up(MAPLE_A);
     gpio_pull_up(MAPLE_B);
     
-    // RP2350 has enhanced PIO capabilities
-    // - More PIO state machines available
-    // - Higher clock speeds for PIO
-    // - Better interrupt handling
-    
-    // TODO: Initialize PIO programs for Maple communication
-    // RP2350 can handle more complex PIO programs with better performance
-    // This is where the maple.pio TX/RX programs would be loaded
-    // and state machines configured for MAPLE_A and MAPLE_B pins
+    // Load the maple.pio TX/RX programs, start streaming the RX FIFO into the
+    // ring buffer and hand every complete packet to ConsumePacket()
+    spsc_queue_init(&event_queue, event_queue_storage, sizeof(maple_event_t), EVENT_QUEUE_SIZE);
+    BuildInfoPackets();
+    maple_bus_init(ConsumePacket);
     
     printf("Maple bus pins GP%d and GP%d initialized for RP2350\n", MAPLE_A, MAPLE_B);
 }
@@ -181,24 +238,46 @@ void initialize_usb_host(void) {
 void initialize_peripherals(void) {
     printf("Initializing peripherals...\n");
     
+    // Before anything that can post one, or trace
+    events_init();
+    trace_init();
+    latency_init();
+    
     // Initialize display
     displayInit();
+    vmu_lcd_init();
+#if ENABLE_RUMBLE
+    rumble_init(MAPLE_PAD_SLOT);
+#endif
     printf("Display initialized\n");
     
     // Initialize SD card
     sd_card_available = sd_init();
     if (sd_card_available) {
         printf("SD card initialized successfully\n");
+        // VMU backups are files, a card without a FAT32 volume is left alone
+        if (!fat32_mount()) {
+            printf("SD card has no FAT32 volume, VMU backup disabled\n");
+            sd_card_available = false;
+        }
     } else {
         printf("SD card initialization failed\n");
     }
     
+    // Rebuild the VMU log index. Only reads flash, the settings are in there too
+    vmu_store_init(VMU_FLASH_OFFSET);
+    
     // Read flash configuration
     readFlash();
     
     // Initialize Maple bus
     initialize_maple_bus();
     
+    // Formats a blank page. The store waits for the Maple TX DMA to go idle before it
+    // changes anything, so that has to be set up already
+    vmu_store_select_page(currentPage);
+    currentPage = vmu_store_current_page();
+    
     // Initialize USB Host for Xbox 360 controllers
     initialize_usb_host();
     
@@ -207,34 +286,128 @@ void initialize_peripherals(void) {
     gpio_set_dir(OLED_PIN, GPIO_IN);
     gpio_pull_up(OLED_PIN);
     
-    // Initialize page button for VMU page cycling
+    // Initialize page button for VMU page cycling. Both edges, check_page_button() tracks the level
     gpio_init(PAGE_BUTTON);
     gpio_set_dir(PAGE_BUTTON, GPIO_IN);
     gpio_pull_up(PAGE_BUTTON);
+    gpio_set_irq_enabled_with_callback(PAGE_BUTTON, GPIO_IRQ_EDGE_FALL | GPIO_IRQ_EDGE_RISE, true, page_button_irq);
     
     printf("All peripherals initialized\n");
 }
 
 // VMU save/load functions
+#define VMU_SD_BATCH 16 // Blocks per CMD18/CMD25, staged in RAM
+
+// Each page is a raw 128KB image in the root directory, VMU_P1.BIN to VMU_P8.BIN. Opened
+// files are kept, so later saves go straight to their sectors without a directory lookup
+static fat32_file_t vmu_files[VMU_PAGES];
+static bool vmu_file_valid[VMU_PAGES];
+
+static const fat32_file_t *vmu_file(uint8_t page, bool create) {
+    if (vmu_file_valid[page - 1]) {
+        return &vmu_files[page - 1];
+    }
+    
+    char name[13];
+    sprintf(name, "VMU_P%d.BIN", page);
+    fat32_file_t *file = &vmu_files[page - 1];
+    bool opened = create ? fat32_create(name, VMU_PAGE_BYTES, file) : fat32_open(name, file);
+    if (!opened || file->size < VMU_PAGE_BYTES) {
+        printf("No usable VMU image %s on SD\n", name);
+        return NULL;
+    }
+    vmu_file_valid[page - 1] = true;
+    return file;
+}
+
+static uint8_t vmu_sd_buffer[VMU_SD_BATCH * BLOCK_SIZE] __attribute__((aligned(4)));
+
+// The backup runs in the background, one batch on the card at a time while the main loop
+// goes on with USB and Maple events. Each finished batch posts EVENT_VMU_SAVE for the next
+static struct {
+    bool active;
+    uint8_t page;
+    const fat32_file_t *file;
+    uint next_block;     // First block of the batch in flight
+    bool batch_done;
+    bool batch_ok;
+} vmu_backup;
+
+static void vmu_backup_batch_done(bool success, void *context) {
+    vmu_backup.batch_done = true;
+    vmu_backup.batch_ok = success;
+    events_post(EVENT_VMU_SAVE);
+}
+
+static void vmu_backup_submit(void) {
+    // Gathered from RAM or flash wherever each block is. Blocks the Dreamcast writes after
+    // their batch went out set vmu_dirty again for another backup
+    uint i = vmu_backup.next_block;
+    for (uint j = 0; j < VMU_SD_BATCH; j++) {
+        memcpy(&vmu_sd_buffer[j * BLOCK_SIZE], vmu_store_read_block(i + j), BLOCK_SIZE);
+    }
+    vmu_backup.batch_done = false;
+    if (!fat32_submit_write(vmu_backup.file, i, VMU_SD_BATCH, vmu_sd_buffer, vmu_backup_batch_done, NULL)) {
+        // Split across fragments of a copied-on file: write it now instead
+        vmu_backup_batch_done(fat32_write(vmu_backup.file, i, VMU_SD_BATCH, vmu_sd_buffer), NULL);
+    }
+}
+
+// Next step of a backup in progress, after its batch finished
+static void vmu_backup_continue(void) {
+    if (!vmu_backup.batch_ok) {
+        printf("Failed to write VMU page %d blocks %d-%d to SD\n", vmu_backup.page,
+               vmu_backup.next_block, vmu_backup.next_block + VMU_SD_BATCH - 1);
+        TRACE_ERROR(TRACE_VMU_SAVE, vmu_backup.page, 0);
+        vmu_backup.active = false;
+        return;
+    }
+    if (vmu_store_current_page() != vmu_backup.page) {
+        // The rest would come from the new page
+        printf("VMU page %d backup abandoned, page changed\n", vmu_backup.page);
+        TRACE_INFO(TRACE_VMU_SAVE, vmu_backup.page, 2);
+        vmu_backup.active = false;
+        return;
+    }
+    
+    vmu_backup.next_block += VMU_SD_BATCH;
+    if (vmu_backup.next_block >= CARD_BLOCKS) {
+        printf("VMU page %d saved to SD card\n", vmu_backup.page);
+        TRACE_INFO(TRACE_VMU_SAVE, vmu_backup.page, 1);
+        vmu_backup.active = false;
+        return;
+    }
+    vmu_backup_submit();
+}
+
+// Starts a background backup of the whole 128KB page, true if it is under way
 bool save_vmu_to_sd(uint8_t page) {
     if (!sd_card_available) {
         printf("SD card not available\n");
         return false;
     }
+    if (page != vmu_store_current_page()) {
+        printf("Only the current VMU page can be saved\n");
+        return false;
+    }
+    if (page > VMU_PAGES) {
+        return true; // Lives on the card already
+    }
     
-    uint32_t block_addr = 100 + (page * 4); // Each VMU page uses 4 blocks
+    if (vmu_backup.active) {
+        return false;
+    }
     
-    // Write 4 blocks (2048 bytes) for the VMU page
-    for (int i = 0; i < 4; i++) {
-        uint32_t offset = i * 512;
-        bool success = sd_write_block(block_addr + i, &MemoryCard[offset]);
-        if (!success) {
-            printf("Failed to write VMU page %d block %d to SD\n", page, i);
-            return false;
-        }
+    const fat32_file_t *file = vmu_file(page, true);
+    if (!file) {
+        return false;
     }
     
-    printf("VMU page %d saved to SD card\n", page);
+    vmu_backup.active = true;
+    vmu_backup.page = page;
+    vmu_backup.file = file;
+    vmu_backup.next_block = 0;
+    vmu_backup_submit();
     return true;
 }
 
@@ -244,21 +417,34 @@ bool load_vmu_from_sd(uint8_t page) {
         return false;
     }
     
-    uint32_t block_addr = 100 + (page * 4);
+    if (page < 1 || page > VMU_PAGES) {
+        printf("VMU page %d is not kept in flash\n", page);
+        return false;
+    }
+    
+    if (vmu_backup.active) {
+        printf("VMU backup in progress\n");
+        return false;
+    }
     
-    // Read 4 blocks for the VMU page
-    for (int i = 0; i < 4; i++) {
-        uint32_t offset = i * 512;
-        bool success = sd_read_block(block_addr + i, &MemoryCard[offset]);
-        if (!success) {
-            printf("Failed to read VMU page %d block %d from SD\n", page, i);
+    const fat32_file_t *file = vmu_file(page, false);
+    if (!file) {
+        return false;
+    }
+    
+    // Each block is appended to the log on its own, a batch at a time. One that fails leaves
+    // the rest of the page as it was, never half a block
+    for (uint i = 0; i < CARD_BLOCKS; i += VMU_SD_BATCH) {
+        if (!fat32_read(file, i, VMU_SD_BATCH, vmu_sd_buffer)) {
+            printf("Failed to read VMU page %d blocks %d-%d from SD\n", page, i, i + VMU_SD_BATCH - 1);
+            return false;
+        }
+        if (!vmu_store_restore_blocks(page, i, VMU_SD_BATCH, vmu_sd_buffer)) {
+            printf("VMU log full writing page %d blocks %d-%d\n", page, i, i + VMU_SD_BATCH - 1);
             return false;
         }
     }
     
-    // Write to flash
-    updateFlashData();
-    
     printf("VMU page %d loaded from SD card\n", page);
     return true;
 }
@@ -295,7 +481,7 @@ void update_input_source(void) {
     static input_source_t last_source = INPUT_SOURCE_NONE;
     
     // Check for Xbox 360 controller
-    if (xbox360_is_connected()) {
+    if (xbox360_is_connected(MAPLE_PAD_SLOT)) {
         current_input_source = INPUT_SOURCE_XBOX360_USB;
     } else {
         current_input_source = INPUT_SOURCE_NONE;
@@ -318,24 +504,559 @@ void update_input_source(void) {
     }
 }
 
-// Send controller data to Dreamcast via Maple bus
-void send_dreamcast_controller_data(dreamcast_state_t* state) {
-    // TODO: Implement actual Maple bus transmission using PIO
-    // This function will encode the controller state into Maple bus format
-    // and transmit it to the Dreamcast
+// Space padded, not NUL terminated
+static void SetString(char *Dest, const char *Source, uint Length) {
+    uint i = 0;
+    for (; i < Length && Source[i]; i++) Dest[i] = Source[i];
+    for (; i < Length; i++) Dest[i] = ' ';
+}
+
+static void BuildInfoPackets(void) {
+    ControllerInfo.Func = __builtin_bswap32(FUNC_CONTROLLER);
+    ControllerInfo.FuncData[0] = __builtin_bswap32(0x000f06fe); // Buttons, triggers and one analog stick
+    ControllerInfo.FuncData[1] = 0;
+    ControllerInfo.FuncData[2] = 0;
+    ControllerInfo.AreaCode = -1;
+    ControllerInfo.ConnectorDirection = 0;
+    SetString(ControllerInfo.ProductName, "Dreamcast Controller", sizeof(ControllerInfo.ProductName));
+    SetString(ControllerInfo.ProductLicense, "Produced By or Under License From SEGA ENTERPRISES,LTD.",
+              sizeof(ControllerInfo.ProductLicense));
+    ControllerInfo.StandbyPower = 430;
+    ControllerInfo.MaxPower = 500;
+
+    // Function data goes highest function first
+    VMUInfo.Func = __builtin_bswap32(FUNC_LCD | FUNC_MEMORY_CARD);
+    VMUInfo.FuncData[0] = __builtin_bswap32(0x00100500); // 48x32 1bpp screen, one block per frame
+    VMUInfo.FuncData[1] = __builtin_bswap32(0x00410f00); // 256 blocks, 4 phases per block write
+    VMUInfo.FuncData[2] = 0;
+    VMUInfo.AreaCode = -1;
+    VMUInfo.ConnectorDirection = 0;
+    SetString(VMUInfo.ProductName, "Visual Memory", sizeof(VMUInfo.ProductName));
+    SetString(VMUInfo.ProductLicense, "Produced By or Under License From SEGA ENTERPRISES,LTD.",
+              sizeof(VMUInfo.ProductLicense));
+    VMUInfo.StandbyPower = 124;
+    VMUInfo.MaxPower = 130;
+
+#if ENABLE_RUMBLE
+    PuruPuruInfo.Func = __builtin_bswap32(FUNC_VIBRATION);
+    PuruPuruInfo.FuncData[0] = __builtin_bswap32(0x00000101); // One vibration source, settings on the unit
+    PuruPuruInfo.FuncData[1] = 0;
+    PuruPuruInfo.FuncData[2] = 0;
+    PuruPuruInfo.AreaCode = -1;
+    PuruPuruInfo.ConnectorDirection = 0;
+    SetString(PuruPuruInfo.ProductName, "Puru Puru Pack", sizeof(PuruPuruInfo.ProductName));
+    SetString(PuruPuruInfo.ProductLicense, "Produced By or Under License From SEGA ENTERPRISES,LTD.",
+              sizeof(PuruPuruInfo.ProductLicense));
+    PuruPuruInfo.StandbyPower = 200;
+    PuruPuruInfo.MaxPower = 1600;
+
+    PuruPuruMediaInfo[0] = __builtin_bswap32(FUNC_VIBRATION);
+    PuruPuruMediaInfo[1] = __builtin_bswap32(0x3B07E010); // 4-30Hz, all envelope modes
+    PuruPuruCondition = 0;
+    PuruPuruAutoStop = __builtin_bswap32(RUMBLE_AUTO_STOP_DEFAULT << 24);
+#endif
+
+    BuildHotCondition(0);
+    maple_patch_condition(NULL);
+
+    VMUMemoryInfo = (PacketMemoryInfo){__builtin_bswap32(FUNC_MEMORY_CARD), CARD_BLOCKS - 1, 0,
+                                       ROOT_BLOCK, FAT_BLOCK, NUM_FAT_BLOCKS,
+                                       DIRECTORY_BLOCK, NUM_DIRECTORY_BLOCKS, 0, 0,
+                                       NUM_SAVE_BLOCKS, SAVE_BLOCK, 0};
+    VMULCDInfo = (PacketLCDInfo){__builtin_bswap32(FUNC_LCD), VMU_LCD_WIDTH - 1, VMU_LCD_HEIGHT - 1,
+                                 0x10, 0}; // Monochrome
+}
+
+// Header-only reply (ACK, errors) or a reply with a body, addressed back to whoever asked
+static void __not_in_flash_func(SendReply)(const PacketHeader *Request, int8_t Command, uint8_t Unit,
+                                           const uint *Prefix, uint PrefixWords, const uint *Body, uint BodyWords) {
+    PacketHeader Reply = {Command, Request->Origin, last_port | Unit, 0};
+    maple_tx_send(&Reply, Prefix, PrefixWords, Body, BodyWords);
+}
+
+// The origin of a controller reply tells the Dreamcast which sub-peripherals are plugged in
+static uint8_t __not_in_flash_func(ControllerOrigin)(uint8_t Port) {
+    uint8_t Origin = ADDRESS_CONTROLLER | Port | (vmuEnable ? ADDRESS_SUBPERIPHERAL0 : 0);
+#if ENABLE_RUMBLE
+    if (rumbleEnable) {
+        Origin |= ADDRESS_SUBPERIPHERAL1;
+    }
+#endif
+    return Origin;
+}
+
+// Same folding maple_tx_send() does. Linear in XOR, so a CRC can be patched with the folded
+// difference of the words that changed
+static __force_inline uint FoldCRC(uint XOR) {
+    XOR ^= XOR << 16;
+    XOR ^= XOR << 8;
+    return XOR;
+}
+
+// Full rebuild of both copies. Only needed at boot and when the port or VMU setting changes,
+// which is decided by the poll itself so nothing is being sent from them at the time
+static void __not_in_flash_func(BuildHotCondition)(uint8_t Port) {
+    HotCondition *Hot = &HotConditions[HotIndex];
+    uint NumWords = sizeof(PacketControllerCondition) / sizeof(uint);
     
-    // For now, just log the data being sent (debug)
-    #ifdef MAPLE_DEBUG
-    printf("Sending to DC: btns=%04X, LT=%d, RT=%d, X=%d, Y=%d\n",
-           state->buttons, state->left_trigger, state->right_trigger,
-           state->stick_x, state->stick_y);
-    #endif
+    Hot->BitPairsMinus1 = ((1 + NumWords) * 4 + 1) * 4 - 1;
+    Hot->Header = (PacketHeader){CMD_RESPOND_DATA_TRANSFER, ADDRESS_DREAMCAST | Port, ControllerOrigin(Port), NumWords};
+    Hot->Condition.Condition = __builtin_bswap32(FUNC_CONTROLLER);
+    
+    const uint *Words = (const uint *)Hot;
+    uint XOR = 0;
+    for (uint i = 1; i < HOT_CONDITION_CRC_WORD; i++) {
+        XOR ^= Words[i];
+    }
+    Hot->CRC = FoldCRC(XOR);
+    
+    ram_copy_words(&HotConditions[HotIndex ^ 1], Hot, sizeof(HotCondition));
+}
+
+// Patch the spare copy with the new controller state and make it live. Only the two words
+// holding the 8 input bytes are touched and the CRC is updated from their difference.
+// Core 1 only
+static void __not_in_flash_func(maple_patch_condition)(const dreamcast_state_t* state) {
+    const uint *Live = (const uint *)&HotConditions[HotIndex];
+    uint *Spare = (uint *)&HotConditions[HotIndex ^ 1];
+    
+    // Buttons are active low on the bus. Second analog stick is unused and left centred
+    uint Buttons = 0x0000FFFF, Sticks = 0x80808080;
+    if (state) {
+        Buttons = (uint16_t)~state->buttons | (state->right_trigger << 16) | (state->left_trigger << 24);
+        Sticks = state->stick_x | (state->stick_y << 8) | 0x80800000;
+    }
+    
+    uint Diff = (Live[HOT_CONDITION_BUTTONS_WORD] ^ Buttons) | (Live[HOT_CONDITION_STICKS_WORD] ^ Sticks);
+    if (!Diff) {
+        return;
+    }
+    
+    Spare[HOT_CONDITION_BUTTONS_WORD] = Buttons;
+    Spare[HOT_CONDITION_STICKS_WORD] = Sticks;
+    Spare[HOT_CONDITION_CRC_WORD] = Live[HOT_CONDITION_CRC_WORD] ^
+        FoldCRC(Live[HOT_CONDITION_BUTTONS_WORD] ^ Buttons ^ Live[HOT_CONDITION_STICKS_WORD] ^ Sticks);
+    
+    __dmb(); // Spare is complete before it becomes live
+    HotIndex ^= 1;
+    TRACE_DEBUG(TRACE_MAPLE_CONDITION, Buttons, Sticks);
+}
+
+// Send controller data to Dreamcast via Maple bus - the live pre-encoded packet, as is
+void __not_in_flash_func(send_dreamcast_controller_data)(void) {
+    maple_tx_send_raw((const uint *)&HotConditions[HotIndex], HOT_CONDITION_WORDS);
+}
+
+// Block write from the Dreamcast: Func, Location, then one phase of data. False if the store
+// can't take it yet; Missing then says if core 0 only has to fetch the block or finish with
+// the flash, rather than flush
+static bool __not_in_flash_func(ConsumeBlockWrite)(const uint *Words, uint NumWords, bool *Missing) {
+    if (NumWords < 2) return true;
+    
+    // Location is partition | phase | block, most significant byte first
+    uint Location = __builtin_bswap32(Words[1]);
+    uint Block = Location & 0xFFFF;
+    uint Phase = (Location >> 16) & 0xFF;
+    uint Bytes = (NumWords - 2) * 4;
+    uint Offset = Phase * PHASE_SIZE;
+    
+    if (Bytes > PHASE_SIZE || Offset + Bytes > BLOCK_SIZE || Block >= CARD_BLOCKS) {
+        return true;
+    }
+    
+    polls_since_write = 0;
+    
+    // A writeback must not take the block between picking the slot and finishing the copy
+    uint32_t Lock = vmu_store_lock();
+    uint8_t *Data = vmu_store_write_block(Block);
+    if (Data) {
+        ram_copy_words(&Data[Offset], &Words[2], Bytes);
+    } else {
+        *Missing = vmu_store_block_missing(Block);
+    }
+    vmu_store_unlock(Lock);
+    return Data != NULL;
+}
+
+static void __not_in_flash_func(ConsumeControllerPacket)(const PacketHeader *Header, const uint *Words) {
+    uint8_t Unit = ControllerOrigin(0);
+    
+    switch (Header->Command) {
+        case CMD_DEVICE_REQUEST:
+        case CMD_ALL_STATUS_REQUEST:
+            SendReply(Header, CMD_RESPOND_DEVICE_STATUS, Unit, NULL, 0,
+                      (const uint *)&ControllerInfo, sizeof(ControllerInfo) / sizeof(uint));
+            break;
+            
+        case CMD_GET_CONDITION:
+            if (Header->NumWords < 1 || Words[0] != __builtin_bswap32(FUNC_CONTROLLER)) {
+                SendReply(Header, CMD_RESPOND_FUNC_CODE_UNSUPPORTED, Unit, NULL, 0, NULL, 0);
+            } else {
+                if (HotConditions[HotIndex].Header.Origin != ControllerOrigin(last_port)) {
+                    BuildHotCondition(last_port);
+                }
+                send_dreamcast_controller_data();
+                latency_reply_sent(maple_rx_packet_time(), maple_tx_start_time());
+                
+                // Right after a reply is the best time to stall: the next poll is a frame
+                // away. Once the VMU has been quiet for a while, let core 0 write back a block
+                maple_poll_count++;
+                if (polls_since_write < FLASH_WRITE_DELAY) {
+                    polls_since_write++;
+                } else if (vmu_store_needs_writeback()) {
+                    events_post(EVENT_FLASH_WRITEBACK);
+                }
+            }
+            break;
+            
+        case CMD_RESET_DEVICE:
+        case CMD_SHUTDOWN_DEVICE:
+            SendReply(Header, CMD_RESPOND_COMMAND_ACK, Unit, NULL, 0, NULL, 0);
+            break;
+            
+        default:
+            SendReply(Header, CMD_RESPOND_UNKNOWN_COMMAND, Unit, NULL, 0, NULL, 0);
+            break;
+    }
+}
+
+// Screen writes come in at animation rates, so core 1 only copies the frame out and
+// leaves drawing it to core 0
+static void __not_in_flash_func(ConsumeLCDPacket)(const PacketHeader *Header, const uint *Words) {
+    uint8_t Unit = ADDRESS_SUBPERIPHERAL0;
+    
+    switch (Header->Command) {
+        case CMD_GET_MEMORY_INFORMATION:
+            SendReply(Header, CMD_RESPOND_DATA_TRANSFER, Unit, NULL, 0,
+                      (const uint *)&VMULCDInfo, sizeof(VMULCDInfo) / sizeof(uint));
+            return;
+            
+        case CMD_BLOCK_WRITE:
+            // Func, location (always screen 0, block 0), then the frame
+            if (Header->NumWords < 2 + VMU_LCD_FRAME_WORDS) {
+                SendReply(Header, CMD_RESPOND_FILE_ERROR, Unit, NULL, 0, NULL, 0);
+                return;
+            }
+            vmu_lcd_publish((const uint8_t *)&Words[2]);
+            SendReply(Header, CMD_RESPOND_COMMAND_ACK, Unit, NULL, 0, NULL, 0);
+            events_post(EVENT_LCD);
+            return;
+            
+        default:
+            SendReply(Header, CMD_RESPOND_UNKNOWN_COMMAND, Unit, NULL, 0, NULL, 0);
+            return;
+    }
+}
+
+static void __not_in_flash_func(ConsumeVMUPacket)(const PacketHeader *Header, const uint *Words) {
+    uint8_t Unit = ADDRESS_SUBPERIPHERAL0;
+    
+    switch (Header->Command) {
+        case CMD_DEVICE_REQUEST:
+        case CMD_ALL_STATUS_REQUEST:
+            SendReply(Header, CMD_RESPOND_DEVICE_STATUS, Unit, NULL, 0,
+                      (const uint *)&VMUInfo, sizeof(VMUInfo) / sizeof(uint));
+            return;
+            
+        case CMD_RESET_DEVICE:
+        case CMD_SHUTDOWN_DEVICE:
+            SendReply(Header, CMD_RESPOND_COMMAND_ACK, Unit, NULL, 0, NULL, 0);
+            return;
+            
+        case CMD_GET_MEMORY_INFORMATION:
+        case CMD_BLOCK_READ:
+        case CMD_BLOCK_WRITE:
+        case CMD_BLOCK_COMPLETE_WRITE:
+            break;
+            
+        default:
+            SendReply(Header, CMD_RESPOND_UNKNOWN_COMMAND, Unit, NULL, 0, NULL, 0);
+            return;
+    }
+    
+    if (Header->NumWords >= 1 && Words[0] == __builtin_bswap32(FUNC_LCD)) {
+        ConsumeLCDPacket(Header, Words);
+        return;
+    }
     
-    // Placeholder for PIO transmission
-    // The actual implementation would:
-    // 1. Format data according to Maple bus protocol
-    // 2. Load data into PIO TX FIFO
-    // 3. Trigger PIO state machine to send data
+    // Everything below is addressed to the memory card function
+    if (Header->NumWords < 1 || Words[0] != __builtin_bswap32(FUNC_MEMORY_CARD)) {
+        SendReply(Header, CMD_RESPOND_FUNC_CODE_UNSUPPORTED, Unit, NULL, 0, NULL, 0);
+        return;
+    }
+    
+    if (Header->Command == CMD_GET_MEMORY_INFORMATION) {
+        SendReply(Header, CMD_RESPOND_DATA_TRANSFER, Unit, NULL, 0,
+                  (const uint *)&VMUMemoryInfo, sizeof(VMUMemoryInfo) / sizeof(uint));
+        return;
+    }
+    
+    if (Header->NumWords < 2) {
+        SendReply(Header, CMD_RESPOND_FILE_ERROR, Unit, NULL, 0, NULL, 0);
+        return;
+    }
+    
+    uint Block = __builtin_bswap32(Words[1]) & 0xFFFF;
+    if (Header->Command == CMD_BLOCK_READ) {
+        // Same rule as ConsumeBlockWrite(): no writeback may move, erase or reuse the block
+        // between the lookup and the TX DMA starting on it (a flash write then waits for
+        // the DMA to finish)
+        uint32_t Lock = vmu_store_lock();
+        const uint8_t *Data = vmu_store_read_block(Block);
+        if (Data) {
+            // Func and location echoed back, then the whole block straight out of RAM or XIP
+            SendReply(Header, CMD_RESPOND_DATA_TRANSFER, Unit, Words, 2,
+                      (const uint *)Data, BLOCK_SIZE / sizeof(uint));
+            vmu_store_unlock(Lock);
+            return;
+        }
+        bool Missing = vmu_store_block_missing(Block);
+        vmu_store_unlock(Lock);
+        
+        if (Missing) {
+            // In flash while core 0 is writing it, or on an SD page. Core 0 finishes or reads
+            // it in while the Dreamcast comes back for it
+            SendReply(Header, CMD_RESPOND_SEND_AGAIN, Unit, NULL, 0, NULL, 0);
+            TRACE_INFO(TRACE_MAPLE_SEND_AGAIN, Unit, Block);
+            maple_event_t event = {MAPLE_EVENT_BLOCK_FETCH, Unit, Block};
+            if (spsc_queue_push(&event_queue, &event)) {
+                events_post(EVENT_MAPLE);
+            }
+            return;
+        }
+        SendReply(Header, CMD_RESPOND_FILE_ERROR, Unit, NULL, 0, NULL, 0);
+        return;
+    }
+    
+    bool Missing = false;
+    if (Header->Command == CMD_BLOCK_WRITE && !ConsumeBlockWrite(Words, Header->NumWords, &Missing)) {
+        // Write pool is full, or the block is on the SD card or in flash being written. Have
+        // core 0 flush or fetch and the Dreamcast retry
+        SendReply(Header, CMD_RESPOND_SEND_AGAIN, Unit, NULL, 0, NULL, 0);
+        TRACE_INFO(TRACE_MAPLE_SEND_AGAIN, Unit, Block);
+        maple_event_t event = {MAPLE_EVENT_STORE_FULL, Unit, 0};
+        if (Missing) {
+            event.type = MAPLE_EVENT_BLOCK_FETCH;
+            event.block = Block;
+        }
+        if (spsc_queue_push(&event_queue, &event)) {
+            events_post(EVENT_MAPLE);
+        }
+        return;
+    }
+    SendReply(Header, CMD_RESPOND_COMMAND_ACK, Unit, NULL, 0, NULL, 0);
+    
+    // Persisting is core 0's job, it is told once the block is complete
+    if (Header->Command == CMD_BLOCK_COMPLETE_WRITE) {
+        maple_event_t event = {MAPLE_EVENT_BLOCK_WRITE, Unit, Block};
+        if (spsc_queue_push(&event_queue, &event)) {
+            events_post(EVENT_MAPLE);
+        }
+    }
+}
+
+#if ENABLE_RUMBLE
+// Only the latest condition is kept; core 0 runs the envelope and drives the pad's motors
+static void __not_in_flash_func(ConsumePuruPuruPacket)(const PacketHeader *Header, const uint *Words) {
+    uint8_t Unit = ADDRESS_SUBPERIPHERAL1;
+    
+    switch (Header->Command) {
+        case CMD_DEVICE_REQUEST:
+        case CMD_ALL_STATUS_REQUEST:
+            SendReply(Header, CMD_RESPOND_DEVICE_STATUS, Unit, NULL, 0,
+                      (const uint *)&PuruPuruInfo, sizeof(PuruPuruInfo) / sizeof(uint));
+            return;
+            
+        case CMD_RESET_DEVICE:
+        case CMD_SHUTDOWN_DEVICE:
+            PuruPuruCondition = 0;
+            rumble_set_condition(0);
+            SendReply(Header, CMD_RESPOND_COMMAND_ACK, Unit, NULL, 0, NULL, 0);
+            return;
+            
+        case CMD_GET_CONDITION:
+        case CMD_GET_MEMORY_INFORMATION:
+        case CMD_SET_CONDITION:
+        case CMD_BLOCK_READ:
+        case CMD_BLOCK_WRITE:
+            break;
+            
+        default:
+            SendReply(Header, CMD_RESPOND_UNKNOWN_COMMAND, Unit, NULL, 0, NULL, 0);
+            return;
+    }
+    
+    if (Header->NumWords < 1 || Words[0] != __builtin_bswap32(FUNC_VIBRATION)) {
+        SendReply(Header, CMD_RESPOND_FUNC_CODE_UNSUPPORTED, Unit, NULL, 0, NULL, 0);
+        return;
+    }
+    
+    switch (Header->Command) {
+        case CMD_GET_CONDITION:
+            SendReply(Header, CMD_RESPOND_DATA_TRANSFER, Unit, Words, 1, &PuruPuruCondition, 1);
+            return;
+            
+        case CMD_GET_MEMORY_INFORMATION:
+            SendReply(Header, CMD_RESPOND_DATA_TRANSFER, Unit, NULL, 0, PuruPuruMediaInfo, 2);
+            return;
+            
+        case CMD_SET_CONDITION:
+            if (Header->NumWords < 2) {
+                SendReply(Header, CMD_RESPOND_FILE_ERROR, Unit, NULL, 0, NULL, 0);
+                return;
+            }
+            PuruPuruCondition = Words[1];
+            rumble_set_condition(__builtin_bswap32(Words[1]));
+            SendReply(Header, CMD_RESPOND_COMMAND_ACK, Unit, NULL, 0, NULL, 0);
+            return;
+            
+        case CMD_BLOCK_READ:
+            // Func and location echoed back, then the auto-stop time
+            if (Header->NumWords < 2) {
+                SendReply(Header, CMD_RESPOND_FILE_ERROR, Unit, NULL, 0, NULL, 0);
+                return;
+            }
+            SendReply(Header, CMD_RESPOND_DATA_TRANSFER, Unit, Words, 2, &PuruPuruAutoStop, 1);
+            return;
+            
+        default: // CMD_BLOCK_WRITE, func, location, auto-stop time
+            if (Header->NumWords < 3) {
+                SendReply(Header, CMD_RESPOND_FILE_ERROR, Unit, NULL, 0, NULL, 0);
+                return;
+            }
+            PuruPuruAutoStop = Words[2];
+            rumble_set_auto_stop(__builtin_bswap32(Words[2]) >> 24); // First byte on the wire
+            SendReply(Header, CMD_RESPOND_COMMAND_ACK, Unit, NULL, 0, NULL, 0);
+            return;
+    }
+}
+#endif
+
+// Maple packet dispatcher - called by the RX engine with every complete, CRC-checked packet
+static void __not_in_flash_func(ConsumePacket)(const uint8_t *Packet, uint Size) {
+    const PacketHeader *Header = (const PacketHeader *)Packet;
+    const uint *Words = (const uint *)(Packet + sizeof(PacketHeader));
+    
+    // The RX engine also hears our own replies (addressed to the Dreamcast), skip anything not for us
+    if ((Header->Origin & 0x3F) != ADDRESS_DREAMCAST) {
+        return;
+    }
+    last_port = Header->Destination & 0xC0;
+    
+#if SHOULD_SEND
+    switch (Header->Destination & 0x3F) {
+        case ADDRESS_CONTROLLER:
+            ConsumeControllerPacket(Header, Words);
+            break;
+            
+        case ADDRESS_SUBPERIPHERAL0: // VMU
+            if (vmuEnable) {
+                ConsumeVMUPacket(Header, Words);
+            }
+            break;
+            
+#if ENABLE_RUMBLE
+        case ADDRESS_SUBPERIPHERAL1: // Puru Puru
+            if (rumbleEnable) {
+                ConsumePuruPuruPacket(Header, Words);
+            }
+            break;
+#endif
+            
+        default:
+            break;
+    }
+#endif
+}
+
+// Core 1: the Maple bus engine and nothing else, so display/SD/USB work on core 0 can't
+// delay a reply. All of it runs from RAM and keeps running while core 0 writes flash
+static void __not_in_flash_func(maple_core1_entry)(void) {
+    uint32_t applied_sequence = 0;
+    while (true) {
+        maple_rx_task();
+        
+        // Freshest controller state, without ever waiting on core 0
+        if (xbox360_snapshot_sequence(MAPLE_PAD_SLOT) != applied_sequence) {
+            dreamcast_snapshot_t snapshot;
+            if (xbox360_read_snapshot(MAPLE_PAD_SLOT, &snapshot)) {
+                maple_patch_condition(&snapshot.state);
+                applied_sequence = snapshot.sequence;
+                latency_input_applied(snapshot.timestamp_us);
+            }
+        }
+    }
+}
+
+void launch_maple_core1(void) {
+    multicore_launch_core1(maple_core1_entry);
+    printf("Maple bus running on core 1\n");
+}
+
+static int64_t vmu_save_alarm_cb(alarm_id_t id, void *user_data) {
+    vmu_save_alarm = 0;
+    events_post(EVENT_VMU_SAVE);
+    return 0; // One shot
+}
+
+static bool status_timer_cb(struct repeating_timer *t) {
+    events_post(EVENT_DISPLAY);
+    return true;
+}
+
+static void page_button_irq(uint gpio, uint32_t events) {
+    events_post(EVENT_PAGE_BUTTON);
+}
+
+// Core 0: act on what core 1 reported
+void handle_maple_events(void) {
+    maple_event_t event;
+    while (spsc_queue_pop(&event_queue, &event)) {
+        switch (event.type) {
+            case MAPLE_EVENT_BLOCK_WRITE:
+                TRACE_DEBUG(TRACE_VMU_BLOCK_WRITE, currentPage, event.block);
+                vmu_dirty = true;
+                
+                // Back up the page once the Dreamcast has gone quiet, saves are many blocks long.
+                // Every write pushes the deadline out again
+                if (vmu_save_alarm > 0) {
+                    cancel_alarm(vmu_save_alarm);
+                }
+                vmu_save_alarm = add_alarm_in_us(VMU_SAVE_DELAY_US, vmu_save_alarm_cb, NULL, true);
+                break;
+                
+            case MAPLE_EVENT_STORE_FULL:
+                vmu_store_flush();
+                break;
+                
+            case MAPLE_EVENT_BLOCK_FETCH:
+                vmu_store_fetch(event.block);
+                break;
+                
+            default:
+                break;
+        }
+    }
+}
+
+void handle_vmu_save(void) {
+    if (vmu_backup.active) {
+        if (!vmu_backup.batch_done) {
+            return;
+        }
+        vmu_backup_continue();
+        if (vmu_backup.active) {
+            return;
+        }
+    }
+    
+    // Once the Dreamcast has gone quiet. Writes during a backup leave vmu_dirty set for another
+    if (vmu_dirty && vmu_save_alarm <= 0) {
+        vmu_dirty = false;
+        if (sd_card_available) {
+            save_vmu_to_sd(currentPage);
+        }
+    }
 }
 
 // Page cycling function using PAGE_BUTTON
@@ -348,8 +1069,12 @@ void check_page_button(void) {
     
     // Check for button press with debounce
     if (button_pressed && !button_was_pressed && (current_time - last_page_press) > 500000) {
+        // Cycle through pages 1-8, then the SD card pages if there is a card
         currentPage++;
-        if (currentPage > 8) currentPage = 1; // Cycle through pages 1-8
+        if (currentPage > VMU_PAGES + (sd_card_available ? VMU_SD_PAGES : 0)) currentPage = 1;
+        
+        // Writes out whatever is pending for the old page first
+        vmu_store_select_page(currentPage);
         
         // Update display to show page change
         clearDisplay();
@@ -366,73 +1091,105 @@ void check_page_button(void) {
     button_was_pressed = button_pressed;
 }
 
-// Main Maple bus communication handler with Xbox 360 input
+static void update_status_display(void) {
+    clearDisplay();
+    putString("MaplePad", 0, 0, color);
+    
+    // Show current VMU page
+    char page_str[16];
+    sprintf(page_str, "Page: %d", currentPage);
+    putString(page_str, 0, 1, color);
+    
+    // Show input source
+    switch (current_input_source) {
+        case INPUT_SOURCE_XBOX360_USB:
+            putString("Xbox360: OK", 0, 2, color);
+            break;
+        case INPUT_SOURCE_NONE:
+            putString("No Controller", 0, 2, color);
+            break;
+        default:
+            putString("Input: Unknown", 0, 2, color);
+            break;
+    }
+    
+    // Show SD card status
+    if (sd_card_available) {
+        putString("SD: OK", 0, 3, color);
+    } else {
+        putString("SD: --", 0, 3, color);
+    }
+    
+    updateDisplay();
+}
+
+// Main Maple bus communication handler with Xbox 360 input. Runs each handler whose
+// event has been posted; the Maple bus itself is serviced on core 1, and the Dreamcast's
+// GetCondition polls are answered there from the latest controller snapshot
 void handle_maple_communication(void) {
-    static uint32_t last_status_update = 0;
-    static uint32_t last_controller_update = 0;
-    uint32_t current_time = time_us_32();
+    // USB report, mount or unmount queued by the USB interrupt
+    if (events_take(EVENT_USB)) {
+        xbox360_task();
+        update_input_source();
+    }
     
-    // Service USB Host stack for Xbox 360 controllers
-    xbox360_task();
+    // SD transfer in the background (VMU backup) has something to do
+    if (events_take(EVENT_SD)) {
+        sd_task();
+    }
     
-    // Update input source detection
-    update_input_source();
+    // Something reported by core 1
+    if (events_take(EVENT_MAPLE)) {
+        handle_maple_events();
+    }
     
-    // Handle controller input at 60Hz (16.67ms intervals)
-    if ((current_time - last_controller_update) > 16670) {
-        if (current_input_source == INPUT_SOURCE_XBOX360_USB) {
-            dreamcast_state_t* dc_state = xbox360_get_dreamcast_state();
-            if (dc_state) {
-                // Send controller data to Dreamcast
-                send_dreamcast_controller_data(dc_state);
-            }
-        }
-        last_controller_update = current_time;
+    // One dirty VMU block or garbage collection step per poll, timed by core 1
+    if (events_take(EVENT_FLASH_WRITEBACK)) {
+        vmu_store_writeback_step();
     }
     
-    // Update display at 1Hz (1 second intervals)
-    if ((current_time - last_status_update) > 1000000) {
-        clearDisplay();
-        putString("MaplePad", 0, 0, color);
-        
-        // Show current VMU page
-        char page_str[16];
-        sprintf(page_str, "Page: %d", currentPage);
-        putString(page_str, 0, 1, color);
-        
-        // Show input source
-        switch (current_input_source) {
-            case INPUT_SOURCE_XBOX360_USB:
-                putString("Xbox360: OK", 0, 2, color);
-                break;
-            case INPUT_SOURCE_NONE:
-                putString("No Controller", 0, 2, color);
-                break;
-            default:
-                putString("Input: Unknown", 0, 2, color);
-                break;
+    if (events_take(EVENT_VMU_SAVE)) {
+        handle_vmu_save();
+    }
+    
+    if (events_take(EVENT_PAGE_BUTTON)) {
+        check_page_button();
+    }
+    
+    // Newest VMU screen frame, any that came in while the last one was drawn are dropped
+    if (events_take(EVENT_LCD)) {
+        vmu_lcd_render(currentPage);
+    }
+    
+#if ENABLE_RUMBLE
+    // New vibration condition from core 1, or the envelope's next step
+    if (events_take(EVENT_RUMBLE)) {
+        rumble_task();
+    }
+#endif
+    
+    // Status screen at 1Hz, unless a game is drawing to the VMU screen. Once there are
+    // latency figures it takes turns with them
+    if (events_take(EVENT_DISPLAY)) {
+        static uint status_refreshes = 0;
+        status_refreshes = (status_refreshes + 1) % DIAG_SCREEN_PERIOD;
+        if (!vmu_lcd_active()) {
+            if (status_refreshes >= DIAG_SCREEN_PERIOD / 2 && latency_summary(LATENCY_INPUT_AGE)->samples) {
+                latency_draw();
+            } else {
+                update_status_display();
+            }
         }
+        latency_task();
         
-        // Show SD card status
-        if (sd_card_available) {
-            putString("SD: OK", 0, 3, color);
-        } else {
-            putString("SD: --", 0, 3, color);
+        // No polls to time writeback against (Dreamcast off or in a menu without a
+        // controller), write whatever is left in one go rather than sit on it
+        static uint32_t last_poll_count = 0;
+        if (maple_poll_count == last_poll_count) {
+            vmu_store_flush();
         }
-        
-        updateDisplay();
-        last_status_update = current_time;
+        last_poll_count = maple_poll_count;
     }
-    
-    // Check for page button presses
-    check_page_button();
-    
-    // TODO: Handle incoming Maple bus communication from Dreamcast
-    // This would include:
-    // - Device info requests
-    // - Controller data requests  
-    // - VMU memory operations
-    // - Rumble commands
 }
 
 // Main function
@@ -453,6 +1210,9 @@ int main() {
     // Initialize all peripherals
     initialize_peripherals();
     
+    // Hand the Maple bus to core 1 before anything slow happens here
+    launch_maple_core1();
+    
     // Show startup splash
     clearDisplay();
     putString("MaplePad", 0, 0, color);
@@ -466,12 +1226,14 @@ int main() {
     
     printf("Initialization complete. Starting Maple communication with Xbox 360 support...\n");
     
-    // Main application loop - Xbox 360 to Dreamcast bridge
+    // Everything from here on is driven by events, get the periodic ones going
+    add_repeating_timer_ms(-STATUS_REFRESH_MS, status_timer_cb, NULL, &status_timer);
+    events_post(EVENT_USB); // Anything that came in during the splash
+    
+    // Main application loop - Xbox 360 to Dreamcast bridge. Sleeps until there is work
     while (true) {
+        events_wait();
         handle_maple_communication();
-        
-        // Small delay to prevent excessive CPU usage
-        sleep_us(100);
     }
     
     return 0;
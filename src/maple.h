@@ -53,6 +53,10 @@
 #define HKT7700 0 // "Seed" (standard controller)
 #define HKT7300 1 // Arcade stick
 
+// USB pad slot (0-3, see xbox360_usb.h) this Maple port follows. Each port of a
+// multi-port build runs its own bus and picks its own slot
+#define MAPLE_PAD_SLOT 0
+
 // Constants
 #define CURRENT_FW_VERSION VER_1_6  // Updated for Xbox 360 support
 #define BLOCK_SIZE 512
@@ -73,7 +77,6 @@
 #define VER_1_7 0x0C
 
 // External variable declarations
-extern uint8_t MemoryCard[];
 extern uint8_t flashData[];
 extern uint16_t color;
 extern bool sd_card_available;
@@ -138,7 +141,39 @@ bool sd_read_block(uint32_t block_addr, uint8_t* data);
 // Xbox 360 controller function declarations
 bool xbox360_init(void);
 void xbox360_task(void);
-bool xbox360_is_connected(void);
+bool xbox360_is_connected(uint8_t slot);
+
+// Maple bus commands (PacketHeader::Command)
+enum ECommands {
+  CMD_RESPOND_FILE_ERROR = -5,
+  CMD_RESPOND_SEND_AGAIN = -4,
+  CMD_RESPOND_UNKNOWN_COMMAND = -3,
+  CMD_RESPOND_FUNC_CODE_UNSUPPORTED = -2,
+  CMD_NO_RESPONSE = -1,
+  CMD_DEVICE_REQUEST = 1,
+  CMD_ALL_STATUS_REQUEST,
+  CMD_RESET_DEVICE,
+  CMD_SHUTDOWN_DEVICE,
+  CMD_RESPOND_DEVICE_STATUS,
+  CMD_RESPOND_ALL_DEVICE_STATUS,
+  CMD_RESPOND_COMMAND_ACK,
+  CMD_RESPOND_DATA_TRANSFER,
+  CMD_GET_CONDITION,
+  CMD_GET_MEMORY_INFORMATION,
+  CMD_BLOCK_READ,
+  CMD_BLOCK_WRITE,
+  CMD_BLOCK_COMPLETE_WRITE,
+  CMD_SET_CONDITION
+};
+
+// Maple function codes. Sent big-endian on the bus, so compare against __builtin_bswap32()
+enum EFunction {
+  FUNC_CONTROLLER = 1,
+  FUNC_MEMORY_CARD = 2,
+  FUNC_LCD = 4,
+  FUNC_TIMER = 8,
+  FUNC_VIBRATION = 0x100
+};
 
 // Packet structures for Maple communication
 typedef struct PacketHeader_s {
@@ -159,6 +194,43 @@ typedef struct PacketDeviceInfo_s {
   uint16_t MaxPower;
 } PacketDeviceInfo;
 
+typedef struct PacketMemoryInfo_s {
+  uint Func;
+  uint16_t TotalSize;
+  uint16_t ParitionNumber;
+  uint16_t SystemArea;
+  uint16_t FATArea;
+  uint16_t NumFATBlocks;
+  uint16_t FileInfoArea;
+  uint16_t NumInfoBlocks;
+  uint8_t VolumeIcon;
+  uint8_t Reserved;
+  uint16_t NumSaveBlocks;
+  uint16_t SaveArea;
+  uint32_t Reserved1;
+} PacketMemoryInfo;
+
+// GetMemoryInformation reply payload for FUNC_LCD
+typedef struct PacketLCDInfo_s {
+  uint Func;
+  uint8_t DotsX;       // Width - 1
+  uint8_t DotsY;       // Height - 1
+  uint8_t Gradation;   // Gradation (high nibble) and contrast (low)
+  uint8_t Reserved;
+} PacketLCDInfo;
+
+// GetCondition reply payload for FUNC_CONTROLLER. Buttons are active low
+typedef struct PacketControllerCondition_s {
+  uint Condition;
+  uint16_t Buttons;
+  uint8_t RightTrigger;
+  uint8_t LeftTrigger;
+  uint8_t JoyX;
+  uint8_t JoyY;
+  uint8_t JoyX2;
+  uint8_t JoyY2;
+} PacketControllerCondition;
+
 // Dreamcast controller state structure (matches Xbox 360 output)
 typedef struct dreamcast_state_s {
     uint16_t buttons;        // Dreamcast button mapping
@@ -168,6 +240,13 @@ typedef struct dreamcast_state_s {
     uint8_t  stick_y;        // 0-255 (128 = center)
 } dreamcast_state_t;
 
+// Controller state as published by the USB side (see xbox360_read_snapshot())
+typedef struct dreamcast_snapshot_s {
+    dreamcast_state_t state;
+    uint32_t timestamp_us;   // time_us_32() when the USB report arrived
+    uint32_t sequence;       // Increments with every publish, 0 = nothing published yet
+} dreamcast_snapshot_t;
+
 // Menu structure
 typedef struct menu_s menu;
 struct menu_s {
@@ -0,0 +1,273 @@
+/*
+ * Maple bus engine
+ * Dreamcast controller emulator for Raspberry Pi Pico (RP2040/RP2350)
+ *
+ * RX: the three maple_rx_triple state machines shift in the state of both bus
+ * pins on every transition and autopush a byte every four transitions. A DMA
+ * channel streams those bytes into a ring buffer, and maple_rx_task() walks the
+ * ring through the precomputed Machine/SetBits tables (see state_machine.c),
+ * so decoding costs one table lookup per four transitions with no per-bit work.
+ *
+ * TX: maple_tx autopulls 32-bit words, bit-pair count first. A packet is a short
+ * list of DMA control blocks (count + header + prefix, body, CRC) which a control
+ * channel feeds to the data channel one after another, so the body goes to the
+ * PIO straight from where it lives (VMU store, controller state) with no copy.
+ */
+
+#include "maple_bus.h"
+#include "maple.h"
+#include "maple.pio.h"
+#include "state_machine.h"
+#include "hardware/clocks.h"
+#include "hardware/dma.h"
+#include "hardware/pio.h"
+
+// maple_tx timing was tuned for a 125MHz system clock divided by 3
+#define MAPLE_TX_PIO_HZ 41666667.0f
+#define MAPLE_RX_CLKDIV 1.0f
+
+// Let the RX DMA run forever. RP2040 has no endless mode so we re-arm it from maple_rx_task()
+#if PICO_RP2350
+#define MAPLE_RX_TRANSFER_COUNT dma_encode_endless_transfer_count()
+#else
+#define MAPLE_RX_TRANSFER_COUNT 0xFFFFFFFFu
+#endif
+
+static PIO maple_tx_pio = pio0;
+static PIO maple_rx_pio = pio1;
+static uint maple_tx_sm = 0;
+static uint maple_rx_sm = 0; // maple_rx_triple1, the one that shifts in the pins
+static uint maple_rx_dma;
+static uint maple_tx_dma;
+static uint maple_tx_ctrl_dma;
+
+static uint8_t RecieveBuffer[MAPLE_RX_RING_SIZE] __attribute__((aligned(MAPLE_RX_RING_SIZE)));
+static uint8_t Packet[MAPLE_RX_PACKET_MAX] __attribute__((aligned(4)));
+
+static maple_packet_handler_t packet_handler = NULL;
+
+// Decoder state. Kept between calls so a packet can straddle several maple_rx_task() calls
+static uint rx_offset = 0;
+static uint rx_state = 0;
+static uint rx_size = 0;
+static uint8_t rx_byte = 0;
+static uint8_t rx_xor = 0;
+static bool rx_valid = false;
+
+static uint32_t rx_packets = 0;
+static uint32_t rx_errors = 0;
+static uint32_t rx_time = 0;
+static uint32_t tx_time = 0;
+
+// One TX control block. Layout matches the data channel's al3_transfer_count/al3_read_addr_trig pair
+typedef struct MapleTXBlock_s {
+  uint Count;
+  const void *Address;
+} MapleTXBlock;
+
+// TX descriptor. Only one packet is queued at a time (the bus is half duplex anyway)
+static uint TXHead[2 + MAPLE_TX_MAX_PREFIX] __attribute__((aligned(4))); // BitPairsMinus1, header, prefix
+static uint TXCRC;
+static MapleTXBlock TXBlocks[4]; // head, body, CRC, null terminator
+
+static void maple_tx_init(void) {
+    maple_tx_dma = dma_claim_unused_channel(true);
+    maple_tx_ctrl_dma = dma_claim_unused_channel(true);
+
+    // Data channel: words -> TX FIFO, hands back to the control channel when each block is done
+    dma_channel_config c = dma_channel_get_default_config(maple_tx_dma);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_32);
+    channel_config_set_read_increment(&c, true);
+    channel_config_set_write_increment(&c, false);
+    channel_config_set_dreq(&c, pio_get_dreq(maple_tx_pio, maple_tx_sm, true));
+    channel_config_set_chain_to(&c, maple_tx_ctrl_dma);
+    channel_config_set_irq_quiet(&c, true); // No IRQ per block, only once when the null terminator ends the chain
+    dma_channel_configure(maple_tx_dma, &c, &maple_tx_pio->txf[maple_tx_sm], NULL, 0, false);
+
+    // Control channel: copies one {count, address} block into the data channel, the address write triggers it
+    c = dma_channel_get_default_config(maple_tx_ctrl_dma);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_32);
+    channel_config_set_read_increment(&c, true);
+    channel_config_set_write_increment(&c, true);
+    channel_config_set_ring(&c, true, 3); // Wrap the write after two words
+    dma_channel_configure(maple_tx_ctrl_dma, &c, &dma_hw->ch[maple_tx_dma].al3_transfer_count, TXBlocks, 2, false);
+}
+
+void maple_bus_init(maple_packet_handler_t Handler) {
+    packet_handler = Handler;
+
+    // ~20KB of tables, built once at boot
+    BuildStateMachineTables();
+
+    // TX state machine sits blocked on its first pull until a packet is queued
+    uint tx_offset = pio_add_program(maple_tx_pio, &maple_tx_program);
+    maple_tx_program_init(maple_tx_pio, maple_tx_sm, tx_offset, MAPLE_A, MAPLE_B,
+                          (float)clock_get_hz(clk_sys) / MAPLE_TX_PIO_HZ);
+    maple_tx_init();
+
+    uint rx_offsets[3];
+    rx_offsets[0] = pio_add_program(maple_rx_pio, &maple_rx_triple1_program);
+    rx_offsets[1] = pio_add_program(maple_rx_pio, &maple_rx_triple2_program);
+    rx_offsets[2] = pio_add_program(maple_rx_pio, &maple_rx_triple3_program);
+    maple_rx_triple_program_init(maple_rx_pio, rx_offsets, MAPLE_A, MAPLE_B, MAPLE_RX_CLKDIV);
+
+    // RX FIFO -> ring buffer. Autopush is 8 bits shifting left so the byte is in the low lane
+    maple_rx_dma = dma_claim_unused_channel(true);
+    dma_channel_config c = dma_channel_get_default_config(maple_rx_dma);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_8);
+    channel_config_set_read_increment(&c, false);
+    channel_config_set_write_increment(&c, true);
+    channel_config_set_ring(&c, true, MAPLE_RX_RING_BITS);
+    channel_config_set_dreq(&c, pio_get_dreq(maple_rx_pio, maple_rx_sm, false));
+    channel_config_set_high_priority(&c, true);
+    dma_channel_configure(maple_rx_dma, &c,
+                          RecieveBuffer,                     // write address
+                          &maple_rx_pio->rxf[maple_rx_sm],   // read address
+                          MAPLE_RX_TRANSFER_COUNT,
+                          true);                             // start
+
+    // All three RX state machines have to start together
+    pio_set_sm_mask_enabled(maple_rx_pio, 0b111, true);
+
+    printf("Maple bus engine running (RX ring %u bytes)\n", MAPLE_RX_RING_SIZE);
+}
+
+static void __not_in_flash_func(maple_rx_end)(void) {
+    bool ok = rx_valid && rx_xor == 0 && rx_size > sizeof(PacketHeader);
+    rx_valid = false; // Nothing more until the next start sequence
+
+    if (ok) {
+        uint Size = rx_size - 1; // Drop the CRC byte
+        const PacketHeader *Header = (const PacketHeader *)Packet;
+        if (Size == (Header->NumWords + 1u) * 4u) {
+            rx_packets++;
+            rx_time = time_us_32();
+            if (packet_handler) {
+                packet_handler(Packet, Size);
+            }
+            return;
+        }
+    }
+    rx_errors++;
+}
+
+// Decode everything the DMA has written since the last call
+void __not_in_flash_func(maple_rx_task)(void) {
+    const uint mask = MAPLE_RX_RING_SIZE - 1;
+    uint write_pos = ((uint)dma_channel_hw_addr(maple_rx_dma)->write_addr - (uint)RecieveBuffer) & mask;
+
+    while (rx_offset != write_pos) {
+        const StateMachine M = Machine[rx_state][RecieveBuffer[rx_offset]];
+        rx_offset = (rx_offset + 1) & mask;
+        rx_state = M.NewState;
+
+        if (M.Reset) {
+            rx_size = 0;
+            rx_xor = 0;
+            rx_byte = 0;
+            rx_valid = true;
+        }
+        if (M.Error && rx_valid) {
+            rx_valid = false;
+            rx_errors++;
+        }
+
+        rx_byte |= SetBits[M.SetBitsIndex][0];
+        if (M.Push) {
+            // Bytes arrive most significant first within each word. Store them
+            // swapped so the packet can be read as native little-endian words
+            if (rx_size < MAPLE_RX_PACKET_MAX) {
+                Packet[rx_size ^ 3] = rx_byte;
+            } else {
+                rx_valid = false;
+            }
+            rx_xor ^= rx_byte;
+            rx_size++;
+            rx_byte = SetBits[M.SetBitsIndex][1];
+        }
+
+        if (M.End) {
+            maple_rx_end();
+        }
+    }
+
+#if !PICO_RP2350
+    // ~70 minutes of bus traffic later the transfer count runs out. Write address
+    // (and so the ring position) is kept, just trigger it again
+    if (!dma_channel_is_busy(maple_rx_dma)) {
+        dma_channel_hw_addr(maple_rx_dma)->al1_transfer_count_trig = MAPLE_RX_TRANSFER_COUNT;
+    }
+#endif
+}
+
+bool __not_in_flash_func(maple_tx_busy)(void) {
+    return dma_channel_is_busy(maple_tx_ctrl_dma) || dma_channel_is_busy(maple_tx_dma);
+}
+
+void __not_in_flash_func(maple_tx_send)(const PacketHeader *Header, const uint *Prefix, uint PrefixWords, const uint *Body, uint BodyWords) {
+    assert(PrefixWords <= MAPLE_TX_MAX_PREFIX);
+
+    // The descriptor is still being read for the previous packet. Whatever has
+    // already reached the FIFO is fine, the PIO sends packets in order
+    while (maple_tx_busy()) {
+        tight_loop_contents();
+    }
+
+    uint NumWords = 1 + PrefixWords + BodyWords; // Header included
+    PacketHeader *TXHeader = (PacketHeader *)&TXHead[1];
+    *TXHeader = *Header;
+    TXHeader->NumWords = PrefixWords + BodyWords;
+    TXHead[0] = (NumWords * 4 + 1) * 4 - 1; // Bit pairs - 1, the CRC is a single byte
+
+    // XOR of every byte ends up in the top byte, which is the only CRC byte sent
+    uint XOR = TXHead[1];
+    for (uint i = 0; i < PrefixWords; i++) {
+        TXHead[2 + i] = Prefix[i];
+        XOR ^= Prefix[i];
+    }
+    for (uint i = 0; i < BodyWords; i++) {
+        XOR ^= Body[i];
+    }
+    XOR ^= XOR << 16;
+    XOR ^= XOR << 8;
+    TXCRC = XOR;
+
+    uint n = 0;
+    TXBlocks[n++] = (MapleTXBlock){2 + PrefixWords, TXHead};
+    if (BodyWords) {
+        TXBlocks[n++] = (MapleTXBlock){BodyWords, Body};
+    }
+    TXBlocks[n++] = (MapleTXBlock){1, &TXCRC};
+    TXBlocks[n] = (MapleTXBlock){0, NULL};
+
+    dma_channel_set_read_addr(maple_tx_ctrl_dma, TXBlocks, true);
+    tx_time = time_us_32();
+}
+
+void __not_in_flash_func(maple_tx_send_raw)(const uint *Words, uint NumWords) {
+    while (maple_tx_busy()) {
+        tight_loop_contents();
+    }
+
+    TXBlocks[0] = (MapleTXBlock){NumWords, Words};
+    TXBlocks[1] = (MapleTXBlock){0, NULL};
+
+    dma_channel_set_read_addr(maple_tx_ctrl_dma, TXBlocks, true);
+    tx_time = time_us_32();
+}
+
+uint32_t maple_rx_packet_count(void) {
+    return rx_packets;
+}
+
+uint32_t maple_rx_error_count(void) {
+    return rx_errors;
+}
+
+uint32_t __not_in_flash_func(maple_rx_packet_time)(void) {
+    return rx_time;
+}
+
+uint32_t __not_in_flash_func(maple_tx_start_time)(void) {
+    return tx_time;
+}
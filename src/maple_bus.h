@@ -0,0 +1,46 @@
+// FILE: src/maple_bus.h
+// Maple bus engine - PIO RX/TX driven by DMA
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "pico/stdlib.h"
+#include "maple.h"
+
+// The RX PIO pushes one byte per four bus transitions (two data bits), so a
+// 512 byte block write is ~2.2KB of RX bytes. 8KB holds two of them back to back.
+#define MAPLE_RX_RING_BITS 13
+#define MAPLE_RX_RING_SIZE (1u << MAPLE_RX_RING_BITS)
+
+// Largest packet we accept: header word + 255 data words + CRC byte (rounded up to a word)
+#define MAPLE_RX_PACKET_MAX ((1 + 255 + 1) * 4)
+
+// Called with a complete, CRC-checked packet. Packet is stored as little-endian
+// words (same layout as the structs in maple.h), Size is in bytes excluding the CRC.
+typedef void (*maple_packet_handler_t)(const uint8_t *Packet, uint Size);
+
+// Words copied into the TX descriptor ahead of the body (function code, block address...)
+#define MAPLE_TX_MAX_PREFIX 4
+
+void maple_bus_init(maple_packet_handler_t Handler);
+void maple_rx_task(void);
+
+// Queue a packet for transmission. Header->NumWords is filled in from the word counts.
+// Prefix is copied, Body is sent in place by DMA and must stay untouched until
+// maple_tx_busy() returns false. Waits for any packet still being queued.
+void maple_tx_send(const PacketHeader *Header, const uint *Prefix, uint PrefixWords, const uint *Body, uint BodyWords);
+bool maple_tx_busy(void);
+
+// Queue a packet that is already fully encoded: bit-pair count, header, data and CRC word.
+// Sent in place, same lifetime rules as the Body of maple_tx_send()
+void maple_tx_send_raw(const uint *Words, uint NumWords);
+
+// Diagnostics
+uint32_t maple_rx_packet_count(void);
+uint32_t maple_rx_error_count(void);
+
+// time_us_32() when the last good packet was decoded, and when the last packet was handed
+// to the TX DMA. With the bus idle its first bit follows right away
+uint32_t maple_rx_packet_time(void);
+uint32_t maple_tx_start_time(void);
@@ -0,0 +1,158 @@
+/*
+ * I2C panel transmit
+ * Dreamcast controller emulator for Raspberry Pi Pico (RP2040/RP2350)
+ *
+ * The I2C block takes 16-bit IC_DATA_CMD words: a byte plus a STOP flag.
+ * A whole panel update (a window command and a data run per dirty band) is
+ * laid out as one stream of those words and handed to a DMA channel paced
+ * by the I2C TX DREQ. The byte after a STOP starts the next transaction on
+ * its own, so the CPU only builds the stream and is never on the bus.
+ *
+ * Two streams: one being sent, one being built. A flush while the first is
+ * still going is picked up by the DMA interrupt, so back to back updates
+ * run into each other without the main loop waiting.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "oled_i2c.h"
+#include "ssd1306.h"
+#include "hardware/dma.h"
+#include "hardware/irq.h"
+#include "hardware/sync.h"
+
+static i2c_inst_t *oled_i2c;
+static int oled_dma = -1;
+static dma_channel_config oled_dma_config;
+
+static uint16_t stream[2][OLED_I2C_STREAM_WORDS];
+static volatile uint stream_len[2];
+static volatile int sending = -1;   // Stream the DMA is reading, -1 when idle
+static volatile int building = 0;   // Stream oled_i2c_write() appends to
+static volatile bool queued = false; // Building stream goes out when the DMA finishes
+
+// Interrupts off
+static void oled_i2c_start(int buffer) {
+    sending = buffer;
+    building = buffer ^ 1;
+    stream_len[building] = 0;
+    queued = false;
+    dma_channel_configure(oled_dma, &oled_dma_config,
+                          &i2c_get_hw(oled_i2c)->data_cmd, // write address
+                          stream[buffer],                  // read address
+                          stream_len[buffer],              // element count
+                          true);                           // start
+}
+
+static void oled_i2c_dma_irq(void) {
+    if (!dma_channel_get_irq1_status(oled_dma)) {
+        return;
+    }
+    dma_channel_acknowledge_irq1(oled_dma);
+
+    // A NACK (no panel) drops the rest of the stream and holds the FIFO until cleared
+    (void)i2c_get_hw(oled_i2c)->clr_tx_abrt;
+
+    if (queued && stream_len[building]) {
+        oled_i2c_start(building);
+    } else {
+        queued = false;
+        sending = -1;
+    }
+}
+
+void oled_i2c_init(i2c_inst_t *i2c, uint8_t address, uint baudrate) {
+    // Each pin pair belongs to one block: GP0/1 I2C0, GP2/3 I2C1, GP4/5 I2C0 and so on
+    if (((I2C_SDA >> 1) & 1) != i2c_get_index(i2c) || ((I2C_SCL >> 1) & 1) != i2c_get_index(i2c)) {
+        printf("OLED: GP%d/GP%d are not I2C%u pins\n", I2C_SDA, I2C_SCL, i2c_get_index(i2c));
+        return;
+    }
+    oled_i2c = i2c;
+    i2c_init(i2c, baudrate);
+    gpio_set_function(I2C_SDA, GPIO_FUNC_I2C);
+    gpio_set_function(I2C_SCL, GPIO_FUNC_I2C);
+    gpio_pull_up(I2C_SDA);
+    gpio_pull_up(I2C_SCL);
+
+    // The DMA never changes the target, set it once
+    i2c_get_hw(i2c)->enable = 0;
+    i2c_get_hw(i2c)->tar = address;
+    i2c_get_hw(i2c)->enable = 1;
+
+    if (oled_dma < 0) {
+        oled_dma = dma_claim_unused_channel(true);
+        oled_dma_config = dma_channel_get_default_config(oled_dma);
+        // Halfword writes land in both halves of DATA_CMD, the upper one is ignored
+        channel_config_set_transfer_data_size(&oled_dma_config, DMA_SIZE_16);
+        channel_config_set_read_increment(&oled_dma_config, true);
+        channel_config_set_write_increment(&oled_dma_config, false);
+        channel_config_set_dreq(&oled_dma_config, i2c_get_dreq(i2c, true));
+        dma_channel_set_irq1_enabled(oled_dma, true);
+        irq_add_shared_handler(DMA_IRQ_1, oled_i2c_dma_irq, PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
+        irq_set_enabled(DMA_IRQ_1, true);
+    }
+}
+
+bool oled_i2c_write(uint8_t control, const uint8_t *bytes, uint len) {
+    uint need = len + 1;
+    if (!oled_i2c || need > OLED_I2C_STREAM_WORDS) {
+        return false;
+    }
+
+    while (true) {
+        // Kept whole, so the interrupt can only ever pick up complete transactions
+        uint32_t interrupts = save_and_disable_interrupts();
+        int b = building;
+        if (stream_len[b] + need <= OLED_I2C_STREAM_WORDS) {
+            uint16_t *dst = &stream[b][stream_len[b]];
+            dst[0] = control;
+            for (uint i = 0; i < len; i++) {
+                dst[i + 1] = bytes[i];
+            }
+            dst[len] |= I2C_IC_DATA_CMD_STOP_BITS;
+            stream_len[b] += need;
+            restore_interrupts(interrupts);
+            return true;
+        }
+        restore_interrupts(interrupts);
+
+        // Full: send it and wait for this one to become the stream in flight
+        oled_i2c_flush();
+        while (queued) {
+            __wfe();
+        }
+    }
+}
+
+void oled_i2c_flush(void) {
+    uint32_t interrupts = save_and_disable_interrupts();
+    if (stream_len[building]) {
+        if (sending < 0) {
+            oled_i2c_start(building);
+        } else {
+            queued = true;
+        }
+    }
+    restore_interrupts(interrupts);
+}
+
+bool oled_i2c_busy(void) {
+    if (sending >= 0 || queued) {
+        return true;
+    }
+    if (!oled_i2c) {
+        return false;
+    }
+    uint32_t status = i2c_get_hw(oled_i2c)->status;
+    return !(status & I2C_IC_STATUS_TFE_BITS) || (status & I2C_IC_STATUS_ACTIVITY_BITS);
+}
+
+void oled_i2c_wait_idle(void) {
+    // The DMA interrupt wakes us, the last few bytes leaving the FIFO don't
+    while (sending >= 0 || queued) {
+        __wfe();
+    }
+    while (oled_i2c_busy()) {
+        tight_loop_contents();
+    }
+}
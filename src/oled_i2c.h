@@ -0,0 +1,32 @@
+// FILE: src/oled_i2c.h
+// DMA-fed I2C transmit for the monochrome panels (SSD1306/SSD1309)
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "pico/stdlib.h"
+#include "hardware/i2c.h"
+#include "display.h"
+
+// Control byte leading each transaction
+#define OLED_I2C_CONTROL_COMMANDS 0x00
+#define OLED_I2C_CONTROL_DATA 0x40
+
+// Worst case update: a window command and a full row of data for every band
+#define OLED_I2C_STREAM_WORDS (DISPLAY_BANDS * (8 + 129))
+
+// Sets up the bus, its pins and the DMA channel. Everything after this goes to address
+void oled_i2c_init(i2c_inst_t *i2c, uint8_t address, uint baudrate);
+
+// Queues one transaction: control byte, then len bytes, then a STOP. The bytes are copied,
+// the caller can change them straight away. False if it can never fit
+bool oled_i2c_write(uint8_t control, const uint8_t *bytes, uint len);
+
+// Sends what has been queued. If a transfer is in flight it follows straight on from the
+// DMA interrupt, nothing waits here
+void oled_i2c_flush(void);
+
+// DMA still feeding the bus, or the bus still sending
+bool oled_i2c_busy(void);
+void oled_i2c_wait_idle(void);
@@ -0,0 +1,25 @@
+// FILE: src/ram_copy.h
+// Copies for code that has to stay in RAM while core 0 writes flash (core 1's Maple side).
+// memcpy() and memset() are library code in flash, and the compiler turns a plain copy loop
+// back into a call to them, hence the volatile stores
+
+#pragma once
+
+#include <stdint.h>
+#include "pico/stdlib.h"
+
+// Both word aligned, bytes a multiple of 4
+static __force_inline void ram_copy_words(void *dst, const void *src, uint bytes) {
+    volatile uint32_t *d = (volatile uint32_t *)dst;
+    const uint32_t *s = (const uint32_t *)src;
+    for (uint i = 0; i < bytes / 4; i++) {
+        d[i] = s[i];
+    }
+}
+
+static __force_inline void ram_zero_words(void *dst, uint bytes) {
+    volatile uint32_t *d = (volatile uint32_t *)dst;
+    for (uint i = 0; i < bytes / 4; i++) {
+        d[i] = 0;
+    }
+}
@@ -0,0 +1,182 @@
+/*
+ * Puru Puru pass-through
+ * Dreamcast controller emulator for Raspberry Pi Pico (RP2040/RP2350)
+ *
+ * A SetCondition describes a whole vibration: intensity, frequency, whether
+ * it swells up to that intensity or dies away from it and how many cycles
+ * each step lasts, and whether it keeps going until the next one. Core 1
+ * only stores the latest condition word. Core 0 turns it into an envelope,
+ * stepped by an alarm that only runs while something is playing.
+ *
+ * The pad only hears about it when the motor levels change, and never more
+ * often than every RUMBLE_REPORT_MS. If its OUT endpoint is still busy, the
+ * next tick sends whatever is current by then. Stale levels are never
+ * queued, and the IN endpoint keeps its own transfers.
+ *
+ * The motors have no frequency control. Low frequencies go to the large
+ * motor and high ones to the small motor, blended in between.
+ */
+
+#include "rumble.h"
+#include "events.h"
+#include "xbox360_usb.h"
+#include "trace.h"
+
+#define RUMBLE_LEVELS 7
+
+typedef struct {
+    bool active;
+    bool continuous;
+    uint8_t level;          // Current intensity, 0-7
+    uint8_t peak;
+    int8_t step;            // -1 convergent, +1 divergent, 0 steady
+    uint8_t freq;
+    uint32_t step_us;       // Time per intensity step (or the whole pulse when steady)
+    absolute_time_t next_step;
+    absolute_time_t stop_at; // nil_time: runs until the envelope ends it
+} rumble_envelope_t;
+
+static uint8_t rumble_slot;
+static volatile uint32_t pending_condition;
+static volatile bool condition_pending = false;
+static volatile uint8_t auto_stop = RUMBLE_AUTO_STOP_DEFAULT;
+
+static rumble_envelope_t envelope;
+static uint8_t sent_large = 0, sent_small = 0;
+static absolute_time_t last_report;
+static volatile alarm_id_t tick_alarm = 0;
+
+void rumble_init(uint8_t slot) {
+    rumble_slot = slot;
+    envelope.active = false;
+    last_report = nil_time;
+}
+
+void __not_in_flash_func(rumble_set_condition)(uint32_t condition) {
+    pending_condition = condition;
+    condition_pending = true;
+    events_post(EVENT_RUMBLE);
+}
+
+void __not_in_flash_func(rumble_set_auto_stop)(uint8_t quarter_seconds) {
+    auto_stop = quarter_seconds;
+}
+
+static int64_t rumble_tick_cb(alarm_id_t id, void *user_data) {
+    tick_alarm = 0;
+    events_post(EVENT_RUMBLE);
+    return 0; // One shot, rearmed while there is something to do
+}
+
+static void rumble_start(uint32_t condition, absolute_time_t now) {
+    uint8_t ctrl = condition >> 24;
+    uint8_t pow = (condition >> 16) & 0xFF;
+    uint8_t freq = (condition >> 8) & 0xFF;
+    uint8_t inc = condition & 0xFF;
+
+    uint8_t forward = RUMBLE_POW_FORWARD(pow), backward = RUMBLE_POW_BACKWARD(pow);
+    envelope.peak = forward > backward ? forward : backward;
+    if (!envelope.peak) {
+        envelope.active = false;
+        envelope.level = 0;
+        return;
+    }
+
+    if (freq < RUMBLE_FREQ_MIN) freq = RUMBLE_FREQ_MIN;
+    if (freq > RUMBLE_FREQ_MAX) freq = RUMBLE_FREQ_MAX;
+    envelope.freq = freq;
+    envelope.step_us = (2000000u / (freq + 1)) * (inc ? inc : 1);
+    envelope.continuous = ctrl & RUMBLE_CTRL_CONTINUOUS;
+
+    if (pow & RUMBLE_POW_CONVERGENT) {
+        envelope.step = -1;
+        envelope.level = envelope.peak;
+    } else if (pow & RUMBLE_POW_DIVERGENT) {
+        envelope.step = 1;
+        envelope.level = 1;
+    } else {
+        envelope.step = 0;
+        envelope.level = envelope.peak;
+    }
+    if (envelope.step > 0 && envelope.level >= envelope.peak) {
+        envelope.step = 0; // Nothing to swell up to
+    }
+    envelope.next_step = delayed_by_us(now, envelope.step_us);
+
+    // Continuous runs until the auto-stop time, a single steady pulse for one step
+    if (envelope.continuous) {
+        envelope.stop_at = delayed_by_ms(now, auto_stop * 250u);
+    } else if (envelope.step == 0) {
+        envelope.stop_at = envelope.next_step;
+    } else {
+        envelope.stop_at = nil_time;
+    }
+    envelope.active = true;
+}
+
+static void rumble_advance(absolute_time_t now) {
+    if (!envelope.active) {
+        return;
+    }
+    if (!is_nil_time(envelope.stop_at) && absolute_time_diff_us(envelope.stop_at, now) >= 0) {
+        envelope.active = false;
+        envelope.level = 0;
+        return;
+    }
+
+    while (envelope.step && absolute_time_diff_us(envelope.next_step, now) >= 0) {
+        envelope.level += envelope.step;
+        envelope.next_step = delayed_by_us(envelope.next_step, envelope.step_us);
+        if (envelope.level == 0) {
+            envelope.active = false;
+            return;
+        }
+        if (envelope.level >= envelope.peak) {
+            // Swelled all the way: hold it, for one more step unless continuous
+            envelope.step = 0;
+            if (!envelope.continuous) {
+                envelope.stop_at = envelope.next_step;
+            }
+        }
+    }
+}
+
+void rumble_task(void) {
+    absolute_time_t now = get_absolute_time();
+
+    if (condition_pending) {
+        condition_pending = false;
+        rumble_start(pending_condition, now);
+    }
+    rumble_advance(now);
+
+    uint8_t large = 0, small = 0;
+    if (envelope.active && envelope.level) {
+        uint32_t strength = envelope.level * 255u / RUMBLE_LEVELS;
+        uint32_t high = envelope.freq - RUMBLE_FREQ_MIN;
+        uint32_t span = RUMBLE_FREQ_MAX - RUMBLE_FREQ_MIN;
+        large = strength * (span - high) / span;
+        small = strength * high / span;
+    }
+
+    bool changed = large != sent_large || small != sent_small;
+    if (changed && (is_nil_time(last_report) ||
+                    absolute_time_diff_us(last_report, now) >= RUMBLE_REPORT_MS * 1000)) {
+        if (xbox360_set_rumble(rumble_slot, large, small)) {
+            TRACE_INFO(TRACE_RUMBLE, large, small);
+            sent_large = large;
+            sent_small = small;
+            last_report = now;
+            changed = false;
+        } else if (!xbox360_is_connected(rumble_slot)) {
+            // Nothing to send it to, the next pad starts still
+            sent_large = large;
+            sent_small = small;
+            changed = false;
+        }
+    }
+
+    if ((envelope.active || changed) && tick_alarm <= 0) {
+        tick_alarm = add_alarm_in_ms(RUMBLE_TICK_MS, rumble_tick_cb, NULL, true);
+    }
+}
@@ -0,0 +1,32 @@
+// FILE: src/rumble.h
+// Puru Puru (vibration) conditions from the Dreamcast, played on the USB pad's motors
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "pico/stdlib.h"
+
+#define RUMBLE_TICK_MS 10          // Envelope step resolution while something is playing
+#define RUMBLE_REPORT_MS 20        // At most one rumble report per this, only when the level changed
+#define RUMBLE_AUTO_STOP_DEFAULT 0x13 // Auto-stop time in 0.25s units (about 5s), as a real pack
+
+// Condition word after bswap32(), wire order most significant byte first: control (31-24),
+// power (23-16), frequency (15-8), increment (7-0)
+#define RUMBLE_CTRL_CONTINUOUS 0x01
+#define RUMBLE_POW_BACKWARD(p) ((p) & 0x07)
+#define RUMBLE_POW_DIVERGENT   0x08
+#define RUMBLE_POW_FORWARD(p)  (((p) >> 4) & 0x07)
+#define RUMBLE_POW_CONVERGENT  0x80
+#define RUMBLE_FREQ_MIN 0x07       // (freq + 1) / 2 Hz, 4Hz..30Hz
+#define RUMBLE_FREQ_MAX 0x3B
+
+void rumble_init(uint8_t slot);
+
+// Core 1. Latest SetCondition / auto-stop time, core 0 picks them up on EVENT_RUMBLE. A
+// condition that arrives before the last was picked up replaces it
+void rumble_set_condition(uint32_t condition);
+void rumble_set_auto_stop(uint8_t quarter_seconds);
+
+// Core 0, on EVENT_RUMBLE: starts new conditions, steps the envelope and sends the level
+void rumble_task(void);
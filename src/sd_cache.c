@@ -0,0 +1,203 @@
+/*
+ * SD block cache
+ * Dreamcast controller emulator for Raspberry Pi Pico (RP2040/RP2350)
+ *
+ * FAT and directory sectors are looked at over and over, and a new file
+ * touches the same few of them several times. They are kept here and
+ * written back in one go on sd_cache_flush(), with neighbouring blocks in
+ * one multi-block write.
+ *
+ * Two misses in a row on consecutive blocks start read-ahead, which fills
+ * the following lines with one CMD18 (walking a directory or a FAT).
+ *
+ * Core 0 only, like the rest of the SD code.
+ */
+
+#include <string.h>
+#include "sd_cache.h"
+
+#define SD_CACHE_BLOCK_SIZE 512
+#define SD_CACHE_NO_BLOCK 0xFFFFFFFF
+
+typedef struct {
+    uint32_t block;      // SD_CACHE_NO_BLOCK = empty
+    uint32_t last_used;
+    bool dirty;
+} cache_line_t;
+
+static cache_line_t lines[SD_CACHE_LINES];
+static uint8_t line_data[SD_CACHE_LINES][SD_CACHE_BLOCK_SIZE] __attribute__((aligned(4)));
+static uint32_t use_counter = 0;
+static uint32_t last_miss = SD_CACHE_NO_BLOCK;
+
+void sd_cache_init(void) {
+    for (uint i = 0; i < SD_CACHE_LINES; i++) {
+        lines[i].block = SD_CACHE_NO_BLOCK;
+        lines[i].dirty = false;
+    }
+    last_miss = SD_CACHE_NO_BLOCK;
+}
+
+static inline uint set_first_line(uint32_t block) {
+    return (block & (SD_CACHE_SETS - 1)) * SD_CACHE_WAYS;
+}
+
+static int find_line(uint32_t block) {
+    uint first = set_first_line(block);
+    for (uint i = first; i < first + SD_CACHE_WAYS; i++) {
+        if (lines[i].block == block) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// Empty or least recently used line of the block's set, written back first if dirty. -1 on error
+static int claim_line(uint32_t block) {
+    uint first = set_first_line(block);
+    uint victim = first;
+    for (uint i = first; i < first + SD_CACHE_WAYS; i++) {
+        if (lines[i].block == SD_CACHE_NO_BLOCK) {
+            victim = i;
+            break;
+        }
+        if (lines[i].last_used < lines[victim].last_used) {
+            victim = i;
+        }
+    }
+
+    if (lines[victim].dirty) {
+        if (!sd_write_block(lines[victim].block, line_data[victim])) {
+            return -1;
+        }
+        lines[victim].dirty = false;
+    }
+    lines[victim].block = SD_CACHE_NO_BLOCK;
+    return victim;
+}
+
+static int load_line(uint32_t block) {
+    int line = find_line(block);
+    if (line >= 0) {
+        lines[line].last_used = ++use_counter;
+        return line;
+    }
+
+    // Sequential misses: take the next few blocks too, up to the first one already cached
+    uint32_t count = 1;
+    if (block == last_miss + 1) {
+        while (count < SD_CACHE_READ_AHEAD && find_line(block + count) < 0) {
+            count++;
+        }
+    }
+    last_miss = block;
+
+    int claimed[SD_CACHE_READ_AHEAD];
+    uint8_t *buffers[SD_CACHE_READ_AHEAD];
+    for (uint32_t i = 0; i < count; i++) {
+        claimed[i] = claim_line(block + i);
+        if (claimed[i] < 0) {
+            return -1;
+        }
+        buffers[i] = line_data[claimed[i]];
+    }
+    if (!sd_read_block_list(block, count, buffers)) {
+        return -1;
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+        lines[claimed[i]].block = block + i;
+        lines[claimed[i]].dirty = false;
+        // Read-ahead lines go out first if nobody asks for them
+        lines[claimed[i]].last_used = i == 0 ? ++use_counter : 0;
+    }
+    return claimed[0];
+}
+
+const uint8_t *sd_cache_read(uint32_t block) {
+    int line = load_line(block);
+    return line < 0 ? NULL : line_data[line];
+}
+
+uint8_t *sd_cache_modify(uint32_t block) {
+    int line = load_line(block);
+    if (line < 0) {
+        return NULL;
+    }
+    lines[line].dirty = true;
+    return line_data[line];
+}
+
+bool sd_cache_flush(void) {
+    // Dirty lines in block order
+    uint order[SD_CACHE_LINES];
+    uint count = 0;
+    for (uint i = 0; i < SD_CACHE_LINES; i++) {
+        if (!lines[i].dirty) continue;
+        uint j = count++;
+        while (j > 0 && lines[order[j - 1]].block > lines[i].block) {
+            order[j] = order[j - 1];
+            j--;
+        }
+        order[j] = i;
+    }
+
+    bool success = true;
+    for (uint run = 0; run < count;) {
+        uint length = 1;
+        while (run + length < count && lines[order[run + length]].block == lines[order[run]].block + length) {
+            length++;
+        }
+
+        const uint8_t *buffers[SD_CACHE_LINES];
+        for (uint i = 0; i < length; i++) {
+            buffers[i] = line_data[order[run + i]];
+        }
+        if (sd_write_block_list(lines[order[run]].block, length, buffers)) {
+            for (uint i = 0; i < length; i++) {
+                lines[order[run + i]].dirty = false;
+            }
+        } else {
+            success = false;
+        }
+        run += length;
+    }
+    return success;
+}
+
+bool sd_cache_read_blocks(uint32_t block, uint32_t count, uint8_t *buffer) {
+    if (!sd_read_multiple_blocks(block, count, buffer)) {
+        return false;
+    }
+    // Newer data that hasn't reached the card yet
+    for (uint i = 0; i < SD_CACHE_LINES; i++) {
+        if (lines[i].dirty && lines[i].block - block < count) {
+            memcpy(&buffer[(lines[i].block - block) * SD_CACHE_BLOCK_SIZE], line_data[i], SD_CACHE_BLOCK_SIZE);
+        }
+    }
+    return true;
+}
+
+// Cached copies would be stale, and dirty ones would later overwrite the new data
+static void invalidate(uint32_t block, uint32_t count) {
+    for (uint i = 0; i < SD_CACHE_LINES; i++) {
+        if (lines[i].block != SD_CACHE_NO_BLOCK && lines[i].block - block < count) {
+            lines[i].block = SD_CACHE_NO_BLOCK;
+            lines[i].dirty = false;
+        }
+    }
+}
+
+bool sd_cache_write_blocks(uint32_t block, uint32_t count, const uint8_t *buffer) {
+    invalidate(block, count);
+    return sd_write_multiple_blocks(block, count, buffer);
+}
+
+// A read of these blocks while the write is in flight misses, and waits for it in sdcard.c
+bool sd_cache_submit_write_blocks(uint32_t block, uint32_t count, const uint8_t *buffer, sd_callback_t callback, void *context) {
+    if (sd_busy()) {
+        return false;
+    }
+    invalidate(block, count);
+    return sd_submit_write(block, count, buffer, callback, context);
+}
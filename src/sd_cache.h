@@ -0,0 +1,33 @@
+// FILE: src/sd_cache.h
+// Set-associative write-back cache of SD card blocks, with sequential read-ahead
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "pico/stdlib.h"
+#include "sdcard.h"
+
+#define SD_CACHE_SETS 4          // Power of two, set = block number % SD_CACHE_SETS
+#define SD_CACHE_WAYS 4          // Lines per set, least recently used one is evicted
+#define SD_CACHE_LINES (SD_CACHE_SETS * SD_CACHE_WAYS)
+#define SD_CACHE_READ_AHEAD 4    // Blocks fetched with one CMD18 when misses are sequential, <= SD_CACHE_SETS
+
+void sd_cache_init(void);
+
+// Cached copy of a block, NULL on a card error. Valid until the next sd_cache call
+const uint8_t *sd_cache_read(uint32_t block);
+
+// Same, marked dirty for the caller to change in place
+uint8_t *sd_cache_modify(uint32_t block);
+
+// Writes every dirty block, consecutive ones coalesced into one CMD25
+bool sd_cache_flush(void);
+
+// Bulk transfers that bypass the cache but stay coherent with it: reads see dirty
+// blocks, writes replace cached copies
+bool sd_cache_read_blocks(uint32_t block, uint32_t count, uint8_t *buffer);
+bool sd_cache_write_blocks(uint32_t block, uint32_t count, const uint8_t *buffer);
+
+// sd_cache_write_blocks() as a background request (see sd_submit_write)
+bool sd_cache_submit_write_blocks(uint32_t block, uint32_t count, const uint8_t *buffer, sd_callback_t callback, void *context);
@@ -1,9 +1,16 @@
 // # FILE: src/sdcard.c (NEW FILE)
 #include "sdcard.h"
+#include "events.h"
+#include "hardware/irq.h"
+#include "hardware/sync.h"
 
 static sd_card_type_t card_type = CARD_TYPE_UNKNOWN;
 static bool sd_initialized = false;
 
+// Paired channels for data blocks: TX feeds the SPI, RX drains it in step
+static int sd_tx_dma = -1;
+static int sd_rx_dma = -1;
+
 bool sd_init(void) {
     // Initialize SPI
     spi_init(SD_SPI_PORT, SD_SPEED_HZ);
@@ -112,125 +119,492 @@ bool sd_init(void) {
         }
     }
     
-    // Increase SPI speed for data transfer
-    spi_set_baudrate(SD_SPI_PORT, 10000000); // 10 MHz
+#if SD_USE_CRC
+    // CRC_ON_OFF: from here on the card rejects commands and data with a bad CRC
+    sd_cs_select();
+    response = sd_send_command(CMD59, 1);
+    sd_cs_deselect();
+    if (response != 0x00) {
+        printf("SD: CMD59 failed\n");
+        return false;
+    }
+#endif
+    
+    // CSD/CMD6 reads below are data transfers too
+    if (sd_tx_dma < 0) {
+        sd_tx_dma = dma_claim_unused_channel(true);
+        sd_rx_dma = dma_claim_unused_channel(true);
+        dma_channel_set_irq1_enabled(sd_rx_dma, true);
+        irq_add_shared_handler(DMA_IRQ_1, sd_dma_irq, PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
+        irq_set_enabled(DMA_IRQ_1, true);
+    }
+    
+    uint32_t clock = sd_negotiate_speed();
+    if (!clock) {
+        printf("SD: No stable SPI clock\n");
+        return false;
+    }
     
     sd_initialized = true;
-    printf("SD: Card initialized successfully, type: %d\n", card_type);
+    printf("SD: Card initialized successfully, type: %d, %u Hz\n", card_type, (unsigned)clock);
     return true;
 }
 
-bool sd_read_block(uint32_t block_addr, uint8_t *buffer) {
-    if (!sd_initialized) return false;
-    
-    // Convert block address for standard capacity cards
-    if (card_type != CARD_TYPE_SDHC) {
-        block_addr *= 512;
-    }
-    
+// CSD register, 16 bytes through the data token path
+static bool sd_read_csd(uint8_t *csd) {
     sd_cs_select();
-    uint8_t response = sd_send_command(CMD17, block_addr);
-    
-    if (response != 0x00) {
-        sd_cs_deselect();
-        return false;
+    bool success = sd_send_command(CMD9, 0) == 0x00 && sd_read_data(csd, 16);
+    sd_cs_deselect();
+    return success;
+}
+
+// CMD6 with its 64-byte switch function status
+static bool sd_switch_function(uint32_t arg, uint8_t *status) {
+    sd_cs_select();
+    bool success = sd_send_command(CMD6, arg) == 0x00 && sd_read_data(status, 64);
+    sd_cs_deselect();
+    return success;
+}
+
+// Picks the SPI clock from what the card says it can do, switching it to high speed if it
+// supports that. The rate is checked by reading the CSD back, and halved until that works.
+// Returns the clock in use, 0 if the card didn't answer even at SD_MIN_SPEED_HZ
+static uint32_t sd_negotiate_speed(void) {
+    uint8_t csd[16];
+    if (!sd_read_csd(csd)) {
+        return 0;
     }
     
-    // Wait for data token
-    uint32_t timeout = 1000;
-    uint32_t start_time = to_ms_since_boot(get_absolute_time());
-    uint8_t token;
-    
-    do {
-        token = sd_spi_transfer(0xFF);
-        if (to_ms_since_boot(get_absolute_time()) - start_time > timeout) {
-            sd_cs_deselect();
-            return false;
+    // TRAN_SPEED 0x32 = 25 MHz default speed, 0x5A = 50 MHz (MMC/legacy values are slower)
+    uint32_t target = csd[3] == 0x5A ? SD_HS_SPEED_HZ : csd[3] == 0x32 ? SD_DS_SPEED_HZ : SD_MIN_SPEED_HZ;
+    
+    // Command class 10 is CMD6. Check mode first, then switch access mode group 1 to high speed
+    uint16_t ccc = (csd[4] << 4) | (csd[5] >> 4);
+    if ((ccc & (1u << 10)) && target == SD_DS_SPEED_HZ) {
+        uint8_t status[64];
+        if (sd_switch_function(0x00FFFFF1, status) && (status[13] & 0x02) &&
+            sd_switch_function(0x80FFFFF1, status) && (status[16] & 0x0F) == 1) {
+            // 8 clocks at the old speed before the card is expected to keep up
+            sd_spi_transfer(0xFF);
+            target = SD_HS_SPEED_HZ;
+            
+            // TRAN_SPEED (and so the CRC7) now reads 0x5A, take the reference again at the old clock
+            if (!sd_read_csd(csd)) {
+                return 0;
+            }
         }
-    } while (token == 0xFF);
-    
-    if (token != 0xFE) {
-        sd_cs_deselect();
-        return false;
     }
     
-    // Read data
-    for (int i = 0; i < 512; i++) {
-        buffer[i] = sd_spi_transfer(0xFF);
+    for (uint32_t speed = target; speed >= SD_MIN_SPEED_HZ; speed /= 2) {
+        // Fastest divider of clk_peri that doesn't exceed the target
+        uint32_t actual = spi_set_baudrate(SD_SPI_PORT, speed);
+        
+        // Wiring and level shifters limit the clock as much as the card does
+        uint8_t check[16];
+        if (sd_read_csd(check) && memcmp(check, csd, sizeof(csd)) == 0) {
+            return actual;
+        }
+        printf("SD: %u Hz unstable\n", (unsigned)actual);
     }
-    
-    // Read CRC (but ignore it)
-    sd_spi_transfer(0xFF);
-    sd_spi_transfer(0xFF);
-    
+    return 0;
+}
+
+// Transfers are split into steps that never wait on the card. Whenever it isn't ready (no
+// data token yet, still programming) the request is left where it is and picked up again by
+// sd_task() on EVENT_SD, posted by the DMA interrupt at the end of a block or by a short
+// alarm while polling. One request at a time, core 0 only
+typedef enum {
+    SD_STATE_IDLE = 0,
+    SD_STATE_COMMAND,      // Select the card and send CMD17/18/24/25
+    SD_STATE_READ_TOKEN,   // Waiting for the data token of the next block
+    SD_STATE_READ_DATA,    // DMA bringing a block in
+    SD_STATE_WRITE_DATA,   // DMA sending a block out
+    SD_STATE_WRITE_BUSY,   // Card programming the block it was just sent
+    SD_STATE_STOP          // CMD12 or stop token sent, waiting for the card to let go
+} sd_state_t;
+
+static struct {
+    sd_state_t state;
+    bool write;
+    uint32_t start_block;
+    uint32_t num_blocks;
+    uint32_t done;              // Blocks through in this attempt
+    uint8_t *buffer;            // Contiguous blocks, or
+    uint8_t *const *blocks;     // one buffer per block
+    bool failed;                // This attempt is lost, finishing the command before a retry
+    int attempt;
+    absolute_time_t deadline;   // For the card wait in progress
+    sd_callback_t callback;
+    void *context;
+} req;
+
+static volatile bool poll_scheduled = false;
+
+static int64_t sd_poll_alarm_cb(alarm_id_t id, void *user_data) {
+    poll_scheduled = false;
+    events_post(EVENT_SD);
+    return 0; // One shot
+}
+
+// Card not ready, look again in a little while
+static void sd_poll_later(void) {
+    if (poll_scheduled) return;
+    poll_scheduled = true;
+    if (add_alarm_in_us(SD_POLL_US, sd_poll_alarm_cb, NULL, true) <= 0) {
+        poll_scheduled = false;
+        events_post(EVENT_SD);
+    }
+}
+
+static void sd_dma_irq(void) {
+    if (dma_channel_get_irq1_status(sd_rx_dma)) {
+        dma_channel_acknowledge_irq1(sd_rx_dma);
+        events_post(EVENT_SD);
+    }
+}
+
+// A few bytes of what the card is sending, true once it isn't fill (0xFF) or busy (0x00)
+static bool sd_poll_card(uint8_t idle, uint8_t *seen) {
+    for (int i = 0; i < SD_POLL_BYTES; i++) {
+        *seen = sd_spi_transfer(0xFF);
+        if (*seen != idle) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static inline uint8_t *req_block(uint32_t i) {
+    return req.blocks ? req.blocks[i] : req.buffer + i * 512;
+}
+
+static void sd_complete(bool success) {
+    req.state = SD_STATE_IDLE;
+    if (!success) {
+        printf("SD: %s of %u blocks at %u failed\n", req.write ? "Write" : "Read",
+               (unsigned)req.num_blocks, (unsigned)req.start_block);
+    }
+    if (req.callback) {
+        req.callback(success, req.context);
+    }
+}
+
+// Card deselected and idle again. Reads have no side effects and rewriting the same data is
+// harmless, so a CRC error (or anything else) repeats the whole command
+static void sd_end_attempt(void) {
     sd_cs_deselect();
-    return true;
+    if (!req.failed) {
+        sd_complete(true);
+    } else if (req.attempt < SD_RETRIES) {
+        req.attempt++;
+        req.state = SD_STATE_COMMAND;
+    } else {
+        sd_complete(false);
+    }
 }
 
-bool sd_write_block(uint32_t block_addr, const uint8_t *buffer) {
-    if (!sd_initialized) return false;
-    
-    // Convert block address for standard capacity cards
-    if (card_type != CARD_TYPE_SDHC) {
-        block_addr *= 512;
+// After the last block, or a failed one: multi-block commands are stopped explicitly
+static void sd_finish_command(void) {
+    if (req.num_blocks == 1) {
+        sd_end_attempt();
+        return;
     }
-    
-    sd_cs_select();
-    uint8_t response = sd_send_command(CMD24, block_addr);
-    
-    if (response != 0x00) {
-        sd_cs_deselect();
-        return false;
+    if (req.write) {
+        sd_spi_transfer(SD_TOKEN_STOP_TRAN);
+        sd_spi_transfer(0xFF);
+    } else if (sd_send_command(CMD12, 0) != 0x00) {
+        req.failed = true;
     }
-    
-    // Send data token
-    sd_spi_transfer(0xFE);
-    
-    // Send data
-    for (int i = 0; i < 512; i++) {
-        sd_spi_transfer(buffer[i]);
+    req.state = SD_STATE_STOP;
+    req.deadline = make_timeout_time_ms(SD_BUSY_TIMEOUT_MS);
+}
+
+static void sd_wait_token(void) {
+    req.state = SD_STATE_READ_TOKEN;
+    req.deadline = make_timeout_time_ms(SD_TOKEN_TIMEOUT_MS);
+}
+
+static void sd_send_block(void) {
+    sd_spi_transfer(req.num_blocks == 1 ? SD_TOKEN_START_BLOCK : SD_TOKEN_START_MULTIPLE);
+    sd_dma_start(req_block(req.done), NULL, 512);
+    req.state = SD_STATE_WRITE_DATA;
+}
+
+// Advances the request as far as it goes without waiting. False when it has to wait for the
+// DMA or the card, with EVENT_SD due once there is something to do
+static bool sd_step(void) {
+    uint8_t seen;
+    
+    switch (req.state) {
+        case SD_STATE_COMMAND: {
+            // Convert block address for standard capacity cards
+            uint32_t addr = card_type == CARD_TYPE_SDHC ? req.start_block : req.start_block * 512;
+            uint8_t cmd = req.write ? (req.num_blocks == 1 ? CMD24 : CMD25)
+                                    : (req.num_blocks == 1 ? CMD17 : CMD18);
+            req.done = 0;
+            req.failed = false;
+            sd_cs_select();
+            if (sd_send_command(cmd, addr) != 0x00) {
+                req.failed = true;
+                sd_end_attempt();
+                return true;
+            }
+            if (req.write) {
+                sd_send_block();
+                return false;
+            }
+            sd_wait_token();
+            return true;
+        }
+        
+        case SD_STATE_READ_TOKEN:
+            if (!sd_poll_card(0xFF, &seen)) {
+                if (time_reached(req.deadline)) {
+                    req.failed = true;
+                    sd_finish_command();
+                    return true;
+                }
+                sd_poll_later();
+                return false;
+            }
+            if (seen != SD_TOKEN_START_BLOCK) {
+                req.failed = true;
+                sd_finish_command();
+                return true;
+            }
+            sd_dma_start(NULL, req_block(req.done), 512);
+            req.state = SD_STATE_READ_DATA;
+            return false;
+            
+        case SD_STATE_READ_DATA: {
+            if (dma_channel_is_busy(sd_rx_dma)) return false;
+            uint16_t crc = sd_spi_transfer(0xFF) << 8;
+            crc |= sd_spi_transfer(0xFF);
+#if SD_USE_CRC
+            if (crc != sd_crc16(req_block(req.done), 512)) {
+                printf("SD: Data CRC error\n");
+                req.failed = true;
+                sd_finish_command();
+                return true;
+            }
+#else
+            (void)crc;
+#endif
+            // The card streams block after block until told to stop
+            if (++req.done < req.num_blocks) {
+                sd_wait_token();
+            } else {
+                sd_finish_command();
+            }
+            return true;
+        }
+        
+        case SD_STATE_WRITE_DATA: {
+            if (dma_channel_is_busy(sd_rx_dma)) return false;
+#if SD_USE_CRC
+            uint16_t crc = sd_crc16(req_block(req.done), 512);
+#else
+            uint16_t crc = 0xFFFF;
+#endif
+            sd_spi_transfer(crc >> 8);
+            sd_spi_transfer(crc & 0xFF);
+            
+            // Data response: 0x05 accepted, 0x0B CRC error, 0x0D write error
+            uint8_t data_response = sd_spi_transfer(0xFF) & 0x1F;
+            if (data_response != 0x05) {
+                if (data_response == 0x0B) {
+                    printf("SD: Card saw a data CRC error\n");
+                }
+                req.failed = true;
+            }
+            // Busy either way, a rejected block may still have an earlier one programming
+            req.state = SD_STATE_WRITE_BUSY;
+            req.deadline = make_timeout_time_ms(SD_BUSY_TIMEOUT_MS);
+            return true;
+        }
+        
+        case SD_STATE_WRITE_BUSY:
+            if (!sd_poll_card(0x00, &seen)) {
+                if (time_reached(req.deadline)) {
+                    req.failed = true;
+                    sd_end_attempt();
+                    return true;
+                }
+                sd_poll_later();
+                return false;
+            }
+            if (!req.failed && ++req.done < req.num_blocks) {
+                sd_send_block();
+                return false;
+            }
+            sd_finish_command();
+            return true;
+            
+        case SD_STATE_STOP:
+            // Busy until the last block is programmed, or the read has stopped
+            if (!sd_poll_card(0x00, &seen)) {
+                if (time_reached(req.deadline)) {
+                    req.failed = true;
+                    sd_end_attempt();
+                    return true;
+                }
+                sd_poll_later();
+                return false;
+            }
+            sd_end_attempt();
+            return true;
+            
+        default:
+            return false;
     }
-    
-    // Send dummy CRC
-    sd_spi_transfer(0xFF);
-    sd_spi_transfer(0xFF);
-    
-    // Check data response
-    uint8_t data_response = sd_spi_transfer(0xFF) & 0x1F;
-    if (data_response != 0x05) {
-        sd_cs_deselect();
+}
+
+void sd_task(void) {
+    while (req.state != SD_STATE_IDLE && sd_step()) {
+    }
+}
+
+bool sd_busy(void) {
+    return req.state != SD_STATE_IDLE;
+}
+
+static bool sd_submit(bool write, uint32_t start_block, uint32_t num_blocks, uint8_t *buffer,
+                      uint8_t *const *blocks, sd_callback_t callback, void *context) {
+    if (!sd_initialized || sd_busy() || num_blocks == 0) {
         return false;
     }
+    req.write = write;
+    req.start_block = start_block;
+    req.num_blocks = num_blocks;
+    req.buffer = buffer;
+    req.blocks = blocks;
+    req.attempt = 0;
+    req.callback = callback;
+    req.context = context;
+    req.state = SD_STATE_COMMAND;
+    sd_task();
+    return true;
+}
+
+bool sd_submit_read(uint32_t start_block, uint32_t num_blocks, uint8_t *buffer, sd_callback_t callback, void *context) {
+    return sd_submit(false, start_block, num_blocks, buffer, NULL, callback, context);
+}
+
+bool sd_submit_write(uint32_t start_block, uint32_t num_blocks, const uint8_t *buffer, sd_callback_t callback, void *context) {
+    // Only ever read from, the DMA source is const as far as the card is concerned
+    return sd_submit(true, start_block, num_blocks, (uint8_t *)buffer, NULL, callback, context);
+}
+
+void sd_wait_idle(void) {
+    while (sd_busy()) {
+        sd_task();
+        if (sd_busy()) {
+            // The DMA interrupt or the poll alarm wakes us
+            __wfe();
+        }
+    }
+}
+
+typedef struct {
+    bool finished;
+    bool success;
+} sd_blocking_result_t;
+
+static void sd_blocking_done(bool success, void *context) {
+    sd_blocking_result_t *result = context;
+    result->finished = true;
+    result->success = success;
+}
+
+// The blocking calls below are a request and a wait. Anything already in flight (a background
+// write) finishes first
+static bool sd_run_blocking(bool write, uint32_t start_block, uint32_t num_blocks, uint8_t *buffer, uint8_t *const *blocks) {
+    if (!sd_initialized) return false;
+    if (num_blocks == 0) return true;
     
-    // Wait for write to complete
-    if (!sd_wait_ready(1000)) {
-        sd_cs_deselect();
+    sd_wait_idle();
+    sd_blocking_result_t result = {false, false};
+    if (!sd_submit(write, start_block, num_blocks, buffer, blocks, sd_blocking_done, &result)) {
         return false;
     }
-    
-    sd_cs_deselect();
-    return true;
+    sd_wait_idle();
+    return result.finished && result.success;
+}
+
+bool sd_read_block(uint32_t block_addr, uint8_t *buffer) {
+    return sd_run_blocking(false, block_addr, 1, buffer, NULL);
+}
+
+bool sd_write_block(uint32_t block_addr, const uint8_t *buffer) {
+    return sd_run_blocking(true, block_addr, 1, (uint8_t *)buffer, NULL);
+}
+
+bool sd_read_multiple_blocks(uint32_t start_block, uint32_t num_blocks, uint8_t *buffer) {
+    return sd_run_blocking(false, start_block, num_blocks, buffer, NULL);
+}
+
+bool sd_write_multiple_blocks(uint32_t start_block, uint32_t num_blocks, const uint8_t *buffer) {
+    return sd_run_blocking(true, start_block, num_blocks, (uint8_t *)buffer, NULL);
+}
+
+bool sd_read_block_list(uint32_t start_block, uint32_t num_blocks, uint8_t *const *blocks) {
+    return sd_run_blocking(false, start_block, num_blocks, NULL, blocks);
+}
+
+bool sd_write_block_list(uint32_t start_block, uint32_t num_blocks, const uint8_t *const *blocks) {
+    return sd_run_blocking(true, start_block, num_blocks, NULL, (uint8_t *const *)blocks);
 }
 
 void sd_deinit(void) {
+    sd_wait_idle();
     sd_initialized = false;
     spi_deinit(SD_SPI_PORT);
 }
 
 // Internal functions
+// CRC7 (x^7 + x^3 + 1) of a command, shifted up with the end bit set
+static uint8_t sd_crc7(const uint8_t *data, size_t len) {
+    uint8_t crc = 0;
+    for (size_t i = 0; i < len; i++) {
+        uint8_t byte = data[i];
+        for (int bit = 0; bit < 8; bit++) {
+            crc <<= 1;
+            if ((byte ^ crc) & 0x80) {
+                crc ^= 0x09;
+            }
+            byte <<= 1;
+        }
+    }
+    return (crc << 1) | 1;
+}
+
+// CRC16-CCITT (x^16 + x^12 + x^5 + 1) of a data block, a byte at a time without a table
+static uint16_t sd_crc16(const uint8_t *data, size_t len) {
+    uint16_t crc = 0;
+    for (size_t i = 0; i < len; i++) {
+        crc = (uint8_t)(crc >> 8) | (uint16_t)(crc << 8);
+        crc ^= data[i];
+        crc ^= (uint8_t)(crc & 0xFF) >> 4;
+        crc ^= (uint16_t)(crc << 12);
+        crc ^= (uint16_t)((crc & 0xFF) << 5);
+    }
+    return crc;
+}
+
 static uint8_t sd_send_command(uint8_t cmd, uint32_t arg) {
-    // Calculate CRC for CMD0 and CMD8
-    uint8_t crc = 0xFF;
-    if (cmd == CMD0) crc = 0x95;
-    if (cmd == CMD8) crc = 0x87;
+    // Always a real CRC7: cheap, and required for every command once CMD59 turns checking on
+    uint8_t packet[6] = {0x40 | cmd, arg >> 24, arg >> 16, arg >> 8, arg, 0};
+    packet[5] = sd_crc7(packet, 5);
     
     // Send command packet
-    sd_spi_transfer(0x40 | cmd);
-    sd_spi_transfer((arg >> 24) & 0xFF);
-    sd_spi_transfer((arg >> 16) & 0xFF);
-    sd_spi_transfer((arg >> 8) & 0xFF);
-    sd_spi_transfer(arg & 0xFF);
-    sd_spi_transfer(crc);
+    for (int i = 0; i < 6; i++) {
+        sd_spi_transfer(packet[i]);
+    }
+    
+    // CMD12 is followed by a stuff byte, possibly still data from the stopped read
+    if (cmd == CMD12) {
+        sd_spi_transfer(0xFF);
+    }
     
     // Wait for response
     uint8_t response;
@@ -243,27 +617,13 @@ static uint8_t sd_send_command(uint8_t cmd, uint32_t arg) {
     return response;
 }
 
-static bool sd_wait_ready(uint32_t timeout_ms) {
-    uint32_t start_time = to_ms_since_boot(get_absolute_time());
-    
-    do {
-        if (sd_spi_transfer(0xFF) == 0xFF) {
-            return true;
-        }
-        if (to_ms_since_boot(get_absolute_time()) - start_time > timeout_ms) {
-            return false;
-        }
-    } while (true);
-}
-
+// No settling delay, the SPI clock is slow next to a GPIO edge
 static void sd_cs_select(void) {
     gpio_put(SD_CS_PIN, 0);
-    sleep_us(1);
 }
 
 static void sd_cs_deselect(void) {
     gpio_put(SD_CS_PIN, 1);
-    sleep_us(1);
 }
 
 static uint8_t sd_spi_transfer(uint8_t data) {
@@ -272,6 +632,68 @@ static uint8_t sd_spi_transfer(uint8_t data) {
     return rx_data;
 }
 
+// DMA both directions at once, the RX channel pacing the TX one through the FIFOs.
+// tx_data NULL clocks out 0xFF, rx_data NULL discards what comes back. The RX channel
+// raises DMA_IRQ_1 when it is done, which posts EVENT_SD
+static void sd_dma_start(const uint8_t *tx_data, uint8_t *rx_data, size_t len) {
+    static const uint8_t fill = 0xFF;
+    static uint8_t discard;
+    
+    dma_channel_config c = dma_channel_get_default_config(sd_tx_dma);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_8);
+    channel_config_set_dreq(&c, spi_get_dreq(SD_SPI_PORT, true));
+    channel_config_set_read_increment(&c, tx_data != NULL);
+    channel_config_set_write_increment(&c, false);
+    dma_channel_configure(sd_tx_dma, &c, &spi_get_hw(SD_SPI_PORT)->dr,
+                          tx_data ? tx_data : &fill, len, false);
+    
+    c = dma_channel_get_default_config(sd_rx_dma);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_8);
+    channel_config_set_dreq(&c, spi_get_dreq(SD_SPI_PORT, false));
+    channel_config_set_read_increment(&c, false);
+    channel_config_set_write_increment(&c, rx_data != NULL);
+    dma_channel_configure(sd_rx_dma, &c, rx_data ? rx_data : &discard,
+                          &spi_get_hw(SD_SPI_PORT)->dr, len, false);
+    
+    dma_start_channel_mask((1u << sd_tx_dma) | (1u << sd_rx_dma));
+}
+
+// Same, waiting for it. Only for the few bytes of card registers during sd_init()
 static void sd_spi_transfer_bulk(const uint8_t *tx_data, uint8_t *rx_data, size_t len) {
-    spi_write_read_blocking(SD_SPI_PORT, tx_data, rx_data, len);
-}
\ No newline at end of file
+    sd_dma_start(tx_data, rx_data, len);
+    // The last byte is in once RX is done, which also means TX is
+    dma_channel_wait_for_finish_blocking(sd_rx_dma);
+}
+
+// Data token, len bytes and their CRC16. Blocking, for the CSD and switch status in sd_init()
+static bool sd_read_data(uint8_t *buffer, size_t len) {
+    // Wait for data token
+    uint32_t timeout = 1000;
+    uint32_t start_time = to_ms_since_boot(get_absolute_time());
+    uint8_t token;
+    
+    do {
+        token = sd_spi_transfer(0xFF);
+        if (to_ms_since_boot(get_absolute_time()) - start_time > timeout) {
+            return false;
+        }
+    } while (token == 0xFF);
+    
+    if (token != SD_TOKEN_START_BLOCK) {
+        return false;
+    }
+    
+    sd_spi_transfer_bulk(NULL, buffer, len);
+    
+    uint16_t crc = sd_spi_transfer(0xFF) << 8;
+    crc |= sd_spi_transfer(0xFF);
+#if SD_USE_CRC
+    if (crc != sd_crc16(buffer, len)) {
+        printf("SD: Data CRC error\n");
+        return false;
+    }
+#else
+    (void)crc;
+#endif
+    return true;
+}
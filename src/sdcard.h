@@ -9,10 +9,33 @@
 #include "pico/stdlib.h"
 #include "hardware/spi.h"
 #include "hardware/gpio.h"
+#include "hardware/dma.h"
 
 // SD Card SPI configuration - CONFLICT-FREE PINS
 #define SD_SPI_PORT spi0  // Using SPI0 instead of SPI1
 #define SD_SPEED_HZ 1000000  // 1MHz for initialization, can go up to 25MHz later
+#define SD_DS_SPEED_HZ 25000000  // Default speed cards
+#define SD_HS_SPEED_HZ 50000000  // After a CMD6 switch to high speed
+#define SD_MIN_SPEED_HZ 10000000 // Lowest clock tried when the faster ones don't read back
+
+// CRC7 on commands is always sent. With SD_USE_CRC the card checks it too (CMD59), and
+// data blocks carry a real CRC16 both ways
+#ifndef SD_USE_CRC
+#define SD_USE_CRC 1
+#endif
+#define SD_RETRIES 2  // Repeats of a transfer that failed its CRC (or anything else)
+
+// Waiting on the card without blocking: a few bytes are looked at per step, then again after
+// SD_POLL_US, until the timeout
+#define SD_POLL_BYTES 8
+#define SD_POLL_US 50
+#define SD_TOKEN_TIMEOUT_MS 100   // Read data token
+#define SD_BUSY_TIMEOUT_MS 500    // Write programming, stop
+
+// Data tokens
+#define SD_TOKEN_START_BLOCK      0xFE  // CMD17/CMD18/CMD24
+#define SD_TOKEN_START_MULTIPLE   0xFC  // CMD25, one per block
+#define SD_TOKEN_STOP_TRAN        0xFD  // Ends CMD25
 
 // NEW CONFLICT-FREE SD CARD PINS
 #define SD_SCK_PIN 2   // Was 10 (conflicted with Start button)
@@ -23,6 +46,7 @@
 // SD Card commands (unchanged)
 #define CMD0    0   // GO_IDLE_STATE
 #define CMD1    1   // SEND_OP_COND (MMC)
+#define CMD6    6   // SWITCH_FUNC
 #define CMD8    8   // SEND_IF_COND
 #define CMD9    9   // SEND_CSD
 #define CMD10   10  // SEND_CID
@@ -43,6 +67,7 @@
 #define CMD41   41  // SEND_OP_COND (SDC)
 #define CMD55   55  // APP_CMD
 #define CMD58   58  // READ_OCR
+#define CMD59   59  // CRC_ON_OFF
 
 // SD Card response types (unchanged)
 #define R1_IDLE_STATE           0x01
@@ -62,18 +87,45 @@ typedef enum {
     CARD_TYPE_SDHC
 } sd_card_type_t;
 
+// Called on core 0 when a submitted request has finished, from sd_task()
+typedef void (*sd_callback_t)(bool success, void *context);
+
 // Function prototypes (unchanged)
 bool sd_init(void);
 bool sd_read_block(uint32_t block_addr, uint8_t *buffer);
 bool sd_write_block(uint32_t block_addr, const uint8_t *buffer);
+// Multi-block transfers stream every block of one CMD18/CMD25 through DMA
 bool sd_read_multiple_blocks(uint32_t start_block, uint32_t num_blocks, uint8_t *buffer);
 bool sd_write_multiple_blocks(uint32_t start_block, uint32_t num_blocks, const uint8_t *buffer);
+// Same, for consecutive card blocks held in separate buffers (see sd_cache.c)
+bool sd_read_block_list(uint32_t start_block, uint32_t num_blocks, uint8_t *const *blocks);
+bool sd_write_block_list(uint32_t start_block, uint32_t num_blocks, const uint8_t *const *blocks);
 void sd_deinit(void);
 
+// Asynchronous transfers, one at a time. False if the card is busy with another request (or
+// absent), otherwise callback runs once the transfer is through; the buffer must stay put
+// until then. Blocking calls above wait for a request in flight before starting
+bool sd_submit_read(uint32_t start_block, uint32_t num_blocks, uint8_t *buffer, sd_callback_t callback, void *context);
+bool sd_submit_write(uint32_t start_block, uint32_t num_blocks, const uint8_t *buffer, sd_callback_t callback, void *context);
+bool sd_busy(void);
+
+// Moves the request in flight along, on EVENT_SD
+void sd_task(void);
+
+// Runs sd_task() (sleeping in between) until nothing is in flight
+void sd_wait_idle(void);
+
 // Internal functions
+static uint8_t sd_crc7(const uint8_t *data, size_t len);
+static uint16_t sd_crc16(const uint8_t *data, size_t len);
 static uint8_t sd_send_command(uint8_t cmd, uint32_t arg);
-static bool sd_wait_ready(uint32_t timeout_ms);
 static void sd_cs_select(void);
 static void sd_cs_deselect(void);
 static uint8_t sd_spi_transfer(uint8_t data);
-static void sd_spi_transfer_bulk(const uint8_t *tx_data, uint8_t *rx_data, size_t len);
\ No newline at end of file
+static void sd_dma_start(const uint8_t *tx_data, uint8_t *rx_data, size_t len);
+static void sd_spi_transfer_bulk(const uint8_t *tx_data, uint8_t *rx_data, size_t len);
+static void sd_dma_irq(void);
+static bool sd_read_data(uint8_t *buffer, size_t len);
+static bool sd_read_csd(uint8_t *csd);
+static bool sd_switch_function(uint32_t arg, uint8_t *status);
+static uint32_t sd_negotiate_speed(void);
\ No newline at end of file
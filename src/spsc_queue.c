@@ -0,0 +1,49 @@
+/*
+ * Single-producer/single-consumer queue
+ * Dreamcast controller emulator for Raspberry Pi Pico (RP2040/RP2350)
+ *
+ * Used between core 0 (USB, display, SD) and core 1 (Maple bus). Indices run
+ * freely and are masked on access, so full is head - tail == capacity.
+ */
+
+#include <string.h>
+#include "spsc_queue.h"
+#include "hardware/sync.h"
+#include "ram_copy.h"
+
+void spsc_queue_init(spsc_queue_t *q, void *storage, uint element_size, uint capacity) {
+    assert((capacity & (capacity - 1)) == 0);
+    assert((element_size & 3) == 0); // Pushed a word at a time
+    q->head = 0;
+    q->tail = 0;
+    q->buffer = (uint8_t *)storage;
+    q->element_size = element_size;
+    q->capacity = capacity;
+}
+
+bool __not_in_flash_func(spsc_queue_push)(spsc_queue_t *q, const void *element) {
+    uint32_t head = q->head;
+    if (head - q->tail >= q->capacity) {
+        return false;
+    }
+    ram_copy_words(q->buffer + (head & (q->capacity - 1)) * q->element_size, element, q->element_size);
+    __dmb(); // Element is visible to the other core before the new head is
+    q->head = head + 1;
+    return true;
+}
+
+bool __not_in_flash_func(spsc_queue_pop)(spsc_queue_t *q, void *element) {
+    uint32_t tail = q->tail;
+    if (q->head == tail) {
+        return false;
+    }
+    __dmb(); // Don't read the element before seeing the head that published it
+    memcpy(element, q->buffer + (tail & (q->capacity - 1)) * q->element_size, q->element_size);
+    __dmb(); // Finished reading before the slot is handed back
+    q->tail = tail + 1;
+    return true;
+}
+
+bool spsc_queue_is_empty(const spsc_queue_t *q) {
+    return q->head == q->tail;
+}
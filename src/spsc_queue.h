@@ -0,0 +1,24 @@
+// FILE: src/spsc_queue.h
+// Single-producer/single-consumer lock-free queue for passing messages between the cores
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "pico/stdlib.h"
+
+// One side pushes, the other pops. head is only written by the producer and tail only
+// by the consumer, so neither needs a lock. Capacity must be a power of two, elements and
+// storage whole words: core 1 pushes from RAM without memcpy() (see ram_copy.h).
+typedef struct spsc_queue_s {
+    volatile uint32_t head;
+    volatile uint32_t tail;
+    uint8_t *buffer;
+    uint element_size;
+    uint capacity;
+} spsc_queue_t;
+
+void spsc_queue_init(spsc_queue_t *q, void *storage, uint element_size, uint capacity);
+bool spsc_queue_push(spsc_queue_t *q, const void *element); // false if full
+bool spsc_queue_pop(spsc_queue_t *q, void *element);        // false if empty
+bool spsc_queue_is_empty(const spsc_queue_t *q);
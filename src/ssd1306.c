@@ -10,12 +10,13 @@
 #include "ssd1306.h"
 #include "maple.h"
 #include "display.h"
+#include "oled_i2c.h"
 
-uint8_t _Framebuffer[SSD1306_FRAMEBUFFER_SIZE + 1] = {0x40};
-uint8_t *Framebuffer = _Framebuffer+1;
+uint8_t Framebuffer[SSD1306_FRAMEBUFFER_SIZE];
 
-static volatile uint dma_tx;
-static dma_channel_config c;
+// What the panel shows, updates only send what differs. Not valid until the first full write
+static uint8_t shown[SSD1306_FRAMEBUFFER_SIZE];
+static bool shownValid = false;
 
 static const uint8_t maple_mono[8192] = {
     //∙∙∙∙∙∙∙∙∙∙∙∙∙∙∙∙∙∙∙∙∙∙∙∙∙∙∙∙∙∙∙∙∙∙∙∙∙∙∙∙∙∙∙∙∙∙∙∙∙∙∙∙∙∙∙∙∙∙∙∙∙∙∙∙∙∙∙∙∙∙∙∙∙∙∙∙∙∙∙∙∙∙∙∙∙∙∙∙∙∙∙∙∙∙∙∙∙∙∙∙∙∙∙∙∙∙∙∙∙∙∙∙∙∙∙∙∙∙∙∙∙∙∙∙∙∙∙∙
@@ -158,6 +159,8 @@ void ssd1306SendCommandBuffer(uint8_t *inbuf, int len) {
 }
 
 void ssd1306_init() {
+    oled_i2c_init(SSD1306_I2C, SSD1306_ADDRESS, I2C_CLOCK * 1000);
+
 uint8_t init_cmds[]=
     {0x00,
     SSD1306_DISPLAYOFF,
@@ -191,12 +194,49 @@ uint8_t init_cmds[]=
 }
   
 // This copies the entire framebuffer to the display.
+static void writeAllSSD1306() {
+    uint8_t window[] = {SSD1306_COLUMNADDR, 0, SSD1306_LCDWIDTH-1, SSD1306_PAGEADDR, 0, 7};
+    oled_i2c_write(OLED_I2C_CONTROL_COMMANDS, window, sizeof(window));
+    oled_i2c_write(OLED_I2C_CONTROL_DATA, Framebuffer, SSD1306_FRAMEBUFFER_SIZE);
+    oled_i2c_flush();
+    memcpy(shown, Framebuffer, SSD1306_FRAMEBUFFER_SIZE);
+    shownValid = true;
+}
+
+// One window per dirty page, just the columns that changed. Queued as one DMA stream that is
+// still going out when this returns
 void updateSSD1306() {
-    i2c_write_blocking(SSD1306_I2C, SSD1306_ADDRESS, _Framebuffer, sizeof(_Framebuffer), false);
+    if (!shownValid) {
+        writeAllSSD1306();
+        for (int page = 0; page < SSD1306_LCDHEIGHT / 8; page++) {
+            int x0, x1;
+            displayTakeDirtyBand(page, &x0, &x1);
+        }
+        return;
+    }
+    
+    for (int page = 0; page < SSD1306_LCDHEIGHT / 8; page++) {
+        int x0, x1;
+        if (!displayTakeDirtyBand(page, &x0, &x1)) continue;
+        if (x1 >= SSD1306_LCDWIDTH) x1 = SSD1306_LCDWIDTH - 1;
+        
+        const uint8_t *row = &Framebuffer[page * SSD1306_LCDWIDTH];
+        uint8_t *shownRow = &shown[page * SSD1306_LCDWIDTH];
+        if (!displayTrimSpan(row, shownRow, 0, 1, 1, &x0, &x1)) continue;
+        
+        uint8_t window[] = {SSD1306_COLUMNADDR, x0, x1, SSD1306_PAGEADDR, page, page};
+        oled_i2c_write(OLED_I2C_CONTROL_COMMANDS, window, sizeof(window));
+        
+        int len = x1 - x0 + 1;
+        oled_i2c_write(OLED_I2C_CONTROL_DATA, &row[x0], len);
+        memcpy(&shownRow[x0], &row[x0], len);
+    }
+    oled_i2c_flush();
 }
 
 void clearSSD1306() {
     memset(Framebuffer, 0, SSD1306_FRAMEBUFFER_SIZE);
+    displayMarkAllDirty();
 }
 
 void splashSSD1306(){
@@ -204,7 +244,7 @@ void splashSSD1306(){
         if(maple_mono[i])
             setPixelSSD1306( i % 128, i / 128, 1);
     }
-    i2c_write_blocking(SSD1306_I2C, SSD1306_ADDRESS, _Framebuffer, sizeof(_Framebuffer), false);
+    writeAllSSD1306();
 }
 
 // thanks, gpt-4! :D
@@ -219,6 +259,44 @@ void setPixelSSD1306(int x, int y, bool on) {
         Framebuffer[byte_idx] |= mask;
     else
         Framebuffer[byte_idx] &= ~mask;
+    displayMarkDirty(x, y, x, y);
+}
+
+// Driver entry points. The framebuffer is pages of 8 rows, a byte per column, bit 0 on top
+
+static void setPixelSSD1306Color(int x, int y, uint16_t color) {
+    if (x < 0 || x >= SSD1306_LCDWIDTH || y < 0 || y >= SSD1306_LCDHEIGHT) return;
+    setPixelSSD1306(x, y, color != 0);
 }
 
+static void fillRectSSD1306(int x, int y, int w, int h, uint16_t color) {
+    displayMonoFillRect(Framebuffer, SSD1306_LCDWIDTH, SSD1306_LCDHEIGHT, x, y, w, h, color);
+}
+
+static void blit1bppSSD1306(int x, int y, int w, int h, const uint8_t *bits, int stride, uint16_t color) {
+    displayMonoBlit1bpp(Framebuffer, SSD1306_LCDWIDTH, SSD1306_LCDHEIGHT, x, y, w, h, bits, stride, color);
+}
+
+static void blitRGB565SSD1306(int x, int y, int w, int h, const uint16_t *pixels) {
+    displayMonoBlitRGB565(Framebuffer, SSD1306_LCDWIDTH, SSD1306_LCDHEIGHT, x, y, w, h, pixels);
+}
+
+static void putGlyphSSD1306(int x, int y, uint8_t c, uint16_t color) {
+    displayMonoPutGlyph(Framebuffer, SSD1306_LCDWIDTH, SSD1306_LCDHEIGHT, x, y, c, color);
+}
 
+const display_driver_t ssd1306Driver = {
+    .name = "SSD1306",
+    .width = SSD1306_LCDWIDTH,
+    .height = SSD1306_LCDHEIGHT,
+    .color = false,
+    .init = ssd1306_init,
+    .update = updateSSD1306,
+    .clear = clearSSD1306,
+    .splash = splashSSD1306,
+    .set_pixel = setPixelSSD1306Color,
+    .fill_rect = fillRectSSD1306,
+    .blit_1bpp = blit1bppSSD1306,
+    .blit_rgb565 = blitRGB565SSD1306,
+    .put_glyph = putGlyphSSD1306,
+};
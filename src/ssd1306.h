@@ -7,10 +7,11 @@
 #include <string.h>
 #include "pico/stdlib.h"
 #include "hardware/i2c.h"
+#include "display.h"
 
 // SSD1306 defines
 #define SSD1306_ADDRESS 0x3C
-#define SSD1306_I2C i2c0
+#define SSD1306_I2C i2c1 // GP10/GP11 below are I2C1 pins, same as the SSD1309
 
 // UPDATED CONFLICT-FREE I2C PINS
 #define I2C_SDA 10   // Was 2 (GP12 when not used for Maple Bus)
@@ -68,4 +69,6 @@ void ssd1306_init();
 void updateSSD1306();
 void clearSSD1306();
 void splashSSD1306();
-void setPixelSSD1306(int x, int y, bool on);
\ No newline at end of file
+void setPixelSSD1306(int x, int y, bool on);
+
+extern const display_driver_t ssd1306Driver;
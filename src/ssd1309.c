@@ -1,9 +1,14 @@
 // # FILE: src/ssd1309.c (NEW FILE)
 #include "ssd1309.h"
-#include "font.h"
+#include "display.h"
+#include "oled_i2c.h"
 
 extern uint8_t frameBuffer[SSD1309_FRAMEBUFFER_SIZE];
 
+// What the panel shows, updates only send what differs. Not valid until the first full write
+static uint8_t shown[SSD1309_FRAMEBUFFER_SIZE];
+static bool shownValid = false;
+
 void ssd1309SendCommand(uint8_t cmd) {
     uint8_t buf[2] = {0x80, cmd};
     i2c_write_blocking(SSD1309_I2C, SSD1309_ADDRESS, buf, 2, false);
@@ -17,11 +22,7 @@ void ssd1309SendCommandBuffer(uint8_t *inbuf, int len) {
 
 void ssd1309_init() {
     // Initialize I2C
-    i2c_init(SSD1309_I2C, I2C_CLOCK * 1000);
-    gpio_set_function(I2C_SDA, GPIO_FUNC_I2C);
-    gpio_set_function(I2C_SCL, GPIO_FUNC_I2C);
-    gpio_pull_up(I2C_SDA);
-    gpio_pull_up(I2C_SCL);
+    oled_i2c_init(SSD1309_I2C, SSD1309_ADDRESS, I2C_CLOCK * 1000);
 
     sleep_ms(100);
 
@@ -60,22 +61,51 @@ void ssd1309_init() {
     updateSSD1309();
 }
 
+// Window commands go as one command stream (control byte 0x00), the data as one run
+static void writeAllSSD1309() {
+    uint8_t payload[] = {SSD1309_PAGEADDR, 0, 7, SSD1309_COLUMNADDR, 0, SSD1309_LCDWIDTH - 1};
+    oled_i2c_write(OLED_I2C_CONTROL_COMMANDS, payload, sizeof(payload));
+    oled_i2c_write(OLED_I2C_CONTROL_DATA, frameBuffer, SSD1309_FRAMEBUFFER_SIZE);
+    oled_i2c_flush();
+    memcpy(shown, frameBuffer, SSD1309_FRAMEBUFFER_SIZE);
+    shownValid = true;
+}
+
+// One window per dirty page, just the columns that changed. A single page window fills the
+// same way in any addressing mode. Queued as one DMA stream that is still going out when
+// this returns
 void updateSSD1309() {
-    uint8_t payload[] = {SSD1309_PAGEADDR, 0, 0xFF, SSD1309_COLUMNADDR, 0, SSD1309_LCDWIDTH - 1};
-    ssd1309SendCommandBuffer(payload, sizeof(payload));
-
-    // Send framebuffer data
-    uint8_t *buf = frameBuffer;
-    for (int i = 0; i < SSD1309_FRAMEBUFFER_SIZE; i += 16) {
-        uint8_t data_buf[17];
-        data_buf[0] = 0x40; // Data continuation
-        memcpy(&data_buf[1], &buf[i], 16);
-        i2c_write_blocking(SSD1309_I2C, SSD1309_ADDRESS, data_buf, 17, false);
+    if (!shownValid) {
+        writeAllSSD1309();
+        for (int page = 0; page < SSD1309_LCDHEIGHT / 8; page++) {
+            int x0, x1;
+            displayTakeDirtyBand(page, &x0, &x1);
+        }
+        return;
     }
+
+    for (int page = 0; page < SSD1309_LCDHEIGHT / 8; page++) {
+        int x0, x1;
+        if (!displayTakeDirtyBand(page, &x0, &x1)) continue;
+        if (x1 >= SSD1309_LCDWIDTH) x1 = SSD1309_LCDWIDTH - 1;
+
+        const uint8_t *row = &frameBuffer[page * SSD1309_LCDWIDTH];
+        uint8_t *shownRow = &shown[page * SSD1309_LCDWIDTH];
+        if (!displayTrimSpan(row, shownRow, 0, 1, 1, &x0, &x1)) continue;
+
+        uint8_t window[] = {SSD1309_COLUMNADDR, x0, x1, SSD1309_PAGEADDR, page, page};
+        oled_i2c_write(OLED_I2C_CONTROL_COMMANDS, window, sizeof(window));
+
+        int len = x1 - x0 + 1;
+        oled_i2c_write(OLED_I2C_CONTROL_DATA, &row[x0], len);
+        memcpy(&shownRow[x0], &row[x0], len);
+    }
+    oled_i2c_flush();
 }
 
 void clearSSD1309() {
     memset(frameBuffer, 0, SSD1309_FRAMEBUFFER_SIZE);
+    displayMarkAllDirty();
 }
 
 void splashSSD1309() {
@@ -106,4 +136,44 @@ void setPixelSSD1309(int x, int y, bool on) {
     } else {
         frameBuffer[byte_idx] &= ~(1 << bit_idx);
     }
-}
\ No newline at end of file
+    displayMarkDirty(x, y, x, y);
+}
+
+// Driver entry points. The framebuffer is pages of 8 rows, a byte per column, bit 0 on top
+
+static void setPixelSSD1309Color(int x, int y, uint16_t color) {
+    if (x < 0 || x >= SSD1309_LCDWIDTH || y < 0 || y >= SSD1309_LCDHEIGHT) return;
+    setPixelSSD1309(x, y, color != 0);
+}
+
+static void fillRectSSD1309(int x, int y, int w, int h, uint16_t color) {
+    displayMonoFillRect(frameBuffer, SSD1309_LCDWIDTH, SSD1309_LCDHEIGHT, x, y, w, h, color);
+}
+
+static void blit1bppSSD1309(int x, int y, int w, int h, const uint8_t *bits, int stride, uint16_t color) {
+    displayMonoBlit1bpp(frameBuffer, SSD1309_LCDWIDTH, SSD1309_LCDHEIGHT, x, y, w, h, bits, stride, color);
+}
+
+static void blitRGB565SSD1309(int x, int y, int w, int h, const uint16_t *pixels) {
+    displayMonoBlitRGB565(frameBuffer, SSD1309_LCDWIDTH, SSD1309_LCDHEIGHT, x, y, w, h, pixels);
+}
+
+static void putGlyphSSD1309(int x, int y, uint8_t c, uint16_t color) {
+    displayMonoPutGlyph(frameBuffer, SSD1309_LCDWIDTH, SSD1309_LCDHEIGHT, x, y, c, color);
+}
+
+const display_driver_t ssd1309Driver = {
+    .name = "SSD1309",
+    .width = SSD1309_LCDWIDTH,
+    .height = SSD1309_LCDHEIGHT,
+    .color = false,
+    .init = ssd1309_init,
+    .update = updateSSD1309,
+    .clear = clearSSD1309,
+    .splash = splashSSD1309,
+    .set_pixel = setPixelSSD1309Color,
+    .fill_rect = fillRectSSD1309,
+    .blit_1bpp = blit1bppSSD1309,
+    .blit_rgb565 = blitRGB565SSD1309,
+    .put_glyph = putGlyphSSD1309,
+};
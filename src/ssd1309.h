@@ -5,6 +5,7 @@
 #include <string.h>
 #include "pico/stdlib.h"
 #include "hardware/i2c.h"
+#include "display.h"
 
 // SSD1309 defines
 #define SSD1309_ADDRESS 0x3C
@@ -70,4 +71,6 @@ void clearSSD1309();
 
 void splashSSD1309();
 
-void setPixelSSD1309(int x, int y, bool on);
\ No newline at end of file
+void setPixelSSD1309(int x, int y, bool on);
+
+extern const display_driver_t ssd1309Driver;
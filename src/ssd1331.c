@@ -5,15 +5,24 @@
 #include "ssd1331.h"
 #include "maple.h"
 #include "display.h"
+#include "font_atlas.h"
 
 #define TRUE 1
 #define FALSE 0
 
-uint8_t oledFB[96 * 64 * 2] = {0x00};
+uint8_t oledFB[96 * 64 * 2] __attribute__((aligned(4))) = {0x00};
 
 static volatile uint dma_tx;
 static dma_channel_config c;
 
+// What the panel shows, updates only send what differs. Not valid until the first full write
+static uint8_t shown[sizeof(oledFB)];
+static bool shownValid = false;
+
+// Dirty bands are gathered here for the DMA, one filling while the other is sent
+static uint8_t stage[2][DISPLAY_BAND_ROWS * OLED_W * 2];
+static int nextStage = 0;
+
 const uint8_t icon[] = {
     // MaplePad splashscreen
     0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, // 0x0010 (16)
@@ -846,6 +855,7 @@ void setPixelSSD1331(const uint8_t x, const uint8_t y, const uint16_t color) {
 
   memset(&oledFB[(y * 192) + (x * 2)], color >> 8, sizeof(uint8_t));
   memset(&oledFB[(y * 192) + (x * 2) + 1], color & 0xff, sizeof(uint8_t));
+  displayMarkDirty(x, y, x, y);
 }
 
 bool getPixelSSD1331(const uint8_t x, const uint8_t y) {
@@ -857,26 +867,70 @@ bool getPixelSSD1331(const uint8_t x, const uint8_t y) {
     return true;
 }
 
-void updateSSD1331() {
+// Commands can't go out until the last pixel of the previous window has left the shifter
+static void waitSSD1331() {
+  dma_channel_wait_for_finish_blocking(dma_tx);
+  while (spi_is_busy(SSD1331_SPI))
+    tight_loop_contents();
+}
+
+static void windowSSD1331(uint8_t x0, uint8_t y0, uint8_t x1, uint8_t y1, const uint8_t *data, uint len) {
+  waitSSD1331();
   gpio_put(DC, 0);
 
-  ssd1331WriteCommand(0x15);
-  ssd1331WriteCommand(0);
-  ssd1331WriteCommand(95);
-  ssd1331WriteCommand(0x75);
-  ssd1331WriteCommand(0);
-  ssd1331WriteCommand(63);
+  ssd1331WriteCommand(SSD1331_CMD_SETCOLUMN);
+  ssd1331WriteCommand(x0);
+  ssd1331WriteCommand(x1);
+  ssd1331WriteCommand(SSD1331_CMD_SETROW);
+  ssd1331WriteCommand(y0);
+  ssd1331WriteCommand(y1);
 
   gpio_put(DC, 1);
 
-  if (!(dma_channel_is_busy(dma_tx)))
-    dma_channel_configure(dma_tx, &c,
-                          &spi_get_hw(SSD1331_SPI)->dr, // write address
-                          oledFB,                       // read address
-                          sizeof(oledFB),               // element count (each element is of size transfer_data_size)
-                          true);                        // start
+  dma_channel_configure(dma_tx, &c,
+                        &spi_get_hw(SSD1331_SPI)->dr, // write address
+                        data,                         // read address
+                        len,                          // element count (each element is of size transfer_data_size)
+                        true);                        // start
+}
 
-  // spi_write_blocking(SSD1331_SPI, oledFB, sizeof(oledFB));
+// One window per dirty band of 8 rows, just the columns that changed. The last one is still
+// going out when this returns
+void updateSSD1331() {
+  if (!shownValid) {
+    windowSSD1331(0, 0, OLED_W - 1, OLED_H - 1, oledFB, sizeof(oledFB));
+    memcpy(shown, oledFB, sizeof(oledFB));
+    shownValid = true;
+    for (int band = 0; band < DISPLAY_BANDS; band++) {
+      int x0, x1;
+      displayTakeDirtyBand(band, &x0, &x1);
+    }
+    return;
+  }
+
+  for (int band = 0; band < DISPLAY_BANDS; band++) {
+    int x0, x1;
+    if (!displayTakeDirtyBand(band, &x0, &x1))
+      continue;
+    if (x1 >= OLED_W)
+      x1 = OLED_W - 1;
+
+    int y0 = band * DISPLAY_BAND_ROWS;
+    uint8_t *rows = &oledFB[y0 * OLED_W * 2];
+    uint8_t *shownRows = &shown[y0 * OLED_W * 2];
+    if (!displayTrimSpan(rows, shownRows, OLED_W * 2, DISPLAY_BAND_ROWS, 2, &x0, &x1))
+      continue;
+
+    // Gathering into the buffer the DMA isn't reading from overlaps the previous window
+    uint rowBytes = (x1 - x0 + 1) * 2;
+    uint8_t *buf = stage[nextStage];
+    for (int r = 0; r < DISPLAY_BAND_ROWS; r++) {
+      memcpy(&buf[r * rowBytes], &rows[r * OLED_W * 2 + x0 * 2], rowBytes);
+      memcpy(&shownRows[r * OLED_W * 2 + x0 * 2], &rows[r * OLED_W * 2 + x0 * 2], rowBytes);
+    }
+    windowSSD1331(x0, y0, x1, y0 + DISPLAY_BAND_ROWS - 1, buf, rowBytes * DISPLAY_BAND_ROWS);
+    nextStage ^= 1;
+  }
 }
 
 void splashSSD1331() {
@@ -900,11 +954,16 @@ void splashSSD1331() {
                         image_data_maplepad_logo_9664,         // read address
                         sizeof(image_data_maplepad_logo_9664), // element count (each element is of size transfer_data_size)
                         true);                                 // start
+  memcpy(shown, image_data_maplepad_logo_9664, sizeof(shown));
+  shownValid = true;
 
   // spi_write_blocking(SSD1331_SPI, oledFB, sizeof(oledFB));
 }
 
-void clearSSD1331() { memset(oledFB, 0, sizeof(oledFB)); }
+void clearSSD1331() {
+  memset(oledFB, 0, sizeof(oledFB));
+  displayMarkAllDirty();
+}
 
 void ssd1331_init() {
   gpio_init(DC);
@@ -966,4 +1025,103 @@ void ssd1331_init() {
   c = dma_channel_get_default_config(dma_tx);
   channel_config_set_transfer_data_size(&c, DMA_SIZE_8);
   channel_config_set_dreq(&c, spi_get_index(SSD1331_SPI) ? DREQ_SPI1_TX : DREQ_SPI0_TX);
-}
\ No newline at end of file
+}
+
+// Driver entry points. The framebuffer is big-endian RGB565, 2 bytes per pixel
+
+static void setPixelSSD1331Color(int x, int y, uint16_t color) {
+  if (x < 0 || x >= OLED_W || y < 0 || y >= OLED_H)
+    return;
+  setPixelSSD1331(x, y, color);
+}
+
+static void fillRectSSD1331(int x, int y, int w, int h, uint16_t color) {
+  int sx, sy;
+  if (!displayClip(OLED_W, OLED_H, &x, &y, &w, &h, &sx, &sy))
+    return;
+
+  for (int r = 0; r < h; r++) {
+    uint8_t *dst = &oledFB[(y + r) * OLED_W * 2 + x * 2];
+    for (int i = 0; i < w; i++) {
+      dst[i * 2] = color >> 8;
+      dst[i * 2 + 1] = color & 0xff;
+    }
+  }
+  displayMarkDirty(x, y, x + w - 1, y + h - 1);
+}
+
+static void blit1bppSSD1331(int x, int y, int w, int h, const uint8_t *bits, int stride, uint16_t color) {
+  int sx, sy;
+  if (!displayClip(OLED_W, OLED_H, &x, &y, &w, &h, &sx, &sy))
+    return;
+
+  for (int r = 0; r < h; r++) {
+    const uint8_t *src = &bits[(sy + r) * stride];
+    uint8_t *dst = &oledFB[(y + r) * OLED_W * 2 + x * 2];
+    for (int i = 0; i < w; i++) {
+      int bit = sx + i;
+      if (src[bit >> 3] & (1 << (bit & 7))) {
+        dst[i * 2] = color >> 8;
+        dst[i * 2 + 1] = color & 0xff;
+      }
+    }
+  }
+  displayMarkDirty(x, y, x + w - 1, y + h - 1);
+}
+
+static void blitRGB565SSD1331(int x, int y, int w, int h, const uint16_t *pixels) {
+  int sx, sy;
+  int stride = w;
+  if (!displayClip(OLED_W, OLED_H, &x, &y, &w, &h, &sx, &sy))
+    return;
+
+  for (int r = 0; r < h; r++) {
+    const uint16_t *src = &pixels[(sy + r) * stride + sx];
+    uint8_t *dst = &oledFB[(y + r) * OLED_W * 2 + x * 2];
+    for (int i = 0; i < w; i++) {
+      dst[i * 2] = src[i] >> 8;
+      dst[i * 2 + 1] = src[i] & 0xff;
+    }
+  }
+  displayMarkDirty(x, y, x + w - 1, y + h - 1);
+}
+
+// Atlas rows are whole RGB565 masks, each pixel a select between the old value and the ink
+static void putGlyphSSD1331(int x, int y, uint8_t c, uint16_t color) {
+  const uint16_t *mask = fontMasks[fontIndex(c)];
+  uint16_t ink = (color >> 8) | (color << 8); // Framebuffer is big-endian
+
+  for (int r = 0; r < FONT_HEIGHT; r++, mask += FONT_WIDTH) {
+    int row = y + r;
+    if (row < 0 || row >= OLED_H)
+      continue;
+    uint16_t *dst = (uint16_t *)&oledFB[row * OLED_W * 2];
+    if (x >= 0 && x + FONT_WIDTH <= OLED_W) {
+      dst += x;
+      for (int i = 0; i < FONT_WIDTH; i++)
+        dst[i] = (dst[i] & ~mask[i]) | (ink & mask[i]);
+    } else {
+      for (int i = 0; i < FONT_WIDTH; i++) {
+        if (x + i >= 0 && x + i < OLED_W)
+          dst[x + i] = (dst[x + i] & ~mask[i]) | (ink & mask[i]);
+      }
+    }
+  }
+  displayMarkDirty(x, y, x + FONT_WIDTH - 1, y + FONT_HEIGHT - 1);
+}
+
+const display_driver_t ssd1331Driver = {
+  .name = "SSD1331",
+  .width = OLED_W,
+  .height = OLED_H,
+  .color = true,
+  .init = ssd1331_init,
+  .update = updateSSD1331,
+  .clear = clearSSD1331,
+  .splash = splashSSD1331,
+  .set_pixel = setPixelSSD1331Color,
+  .fill_rect = fillRectSSD1331,
+  .blit_1bpp = blit1bppSSD1331,
+  .blit_rgb565 = blitRGB565SSD1331,
+  .put_glyph = putGlyphSSD1331,
+};
@@ -10,6 +10,7 @@
 #include "pico/binary_info.h"
 #include "hardware/spi.h"
 #include "hardware/dma.h"
+#include "display.h"
 
 #define SSD1331_SPI spi1
 #define SSD1331_SPEED 50000000
@@ -74,4 +75,6 @@ void setPixelSSD1331(const uint8_t x, const uint8_t y, const uint16_t color);
 void clearSSD1331(void);
 void updateSSD1331(void);
 void splashSSD1331(void);
-void ssd1331_init();
\ No newline at end of file
+void ssd1331_init();
+
+extern const display_driver_t ssd1331Driver;
@@ -0,0 +1,108 @@
+/*
+ * Trace rings
+ * Dreamcast controller emulator for Raspberry Pi Pico (RP2040/RP2350)
+ *
+ * printf formats and waits on the UART in the caller, which core 1 can't
+ * afford inside a Maple reply and core 0 can't afford per USB report. A
+ * trace record is four words stored into a ring. Each core has its own,
+ * so a record is one producer and one consumer with nothing shared. Only
+ * interrupts on the same core can race a writer, and those are held off
+ * for the handful of stores it takes.
+ *
+ * Core 0 is the consumer. It sends whole frames only, and only when the
+ * TX FIFO is empty, so a frame always fits, nothing waits and a printf
+ * can't land in the middle of one. Use tools/trace_decode.py to separate
+ * the frames from the console text.
+ */
+
+#include <string.h>
+#include "trace.h"
+#include "hardware/uart.h"
+#include "hardware/sync.h"
+
+#define TRACE_RING_MASK (TRACE_RING_RECORDS - 1)
+
+typedef struct {
+    volatile uint32_t head;      // Written by the owning core
+    volatile uint32_t tail;      // Written by core 0
+    uint32_t dropped;
+    trace_record_t records[TRACE_RING_RECORDS];
+} trace_ring_t;
+
+static trace_ring_t rings[2];
+static bool dump_requested = false;
+
+void trace_init(void) {
+    memset(rings, 0, sizeof(rings));
+}
+
+void __not_in_flash_func(trace_record)(uint16_t id, uint32_t arg0, uint32_t arg1) {
+    uint core = get_core_num();
+    trace_ring_t *ring = &rings[core];
+    
+    uint32_t interrupts = save_and_disable_interrupts();
+    uint32_t head = ring->head;
+    if (head - ring->tail >= TRACE_RING_RECORDS) {
+        ring->dropped++;
+        restore_interrupts(interrupts);
+        return;
+    }
+    trace_record_t *record = &ring->records[head & TRACE_RING_MASK];
+    record->id = id;
+    record->core = core;
+    record->dropped = ring->dropped > 0xFF ? 0xFF : ring->dropped;
+    record->time_us = time_us_32();
+    record->arg0 = arg0;
+    record->arg1 = arg1;
+    ring->dropped = 0;
+    __dmb(); // Record is complete before the consumer can see it
+    ring->head = head + 1;
+    restore_interrupts(interrupts);
+}
+
+// Oldest record of either core goes first, so the stream stays roughly in time order
+static trace_ring_t *trace_oldest(void) {
+    trace_ring_t *oldest = NULL;
+    for (uint i = 0; i < 2; i++) {
+        trace_ring_t *ring = &rings[i];
+        if (ring->head == ring->tail) {
+            continue;
+        }
+        if (!oldest || (int32_t)(ring->records[ring->tail & TRACE_RING_MASK].time_us -
+                                 oldest->records[oldest->tail & TRACE_RING_MASK].time_us) < 0) {
+            oldest = ring;
+        }
+    }
+    return oldest;
+}
+
+static void trace_send(trace_ring_t *ring) {
+    __dmb(); // See the record the head was published for
+    const uint8_t *bytes = (const uint8_t *)&ring->records[ring->tail & TRACE_RING_MASK];
+    uart_putc_raw(uart_default, TRACE_FRAME_START);
+    for (uint i = 0; i < sizeof(trace_record_t); i++) {
+        uart_putc_raw(uart_default, bytes[i]);
+    }
+    __dmb(); // Done reading before the slot is handed back
+    ring->tail++;
+}
+
+bool trace_idle(void) {
+    if (uart_is_readable(uart_default) && uart_getc(uart_default) == 'T') {
+        dump_requested = true;
+    }
+    if (!TRACE_STREAM && !dump_requested) {
+        return false;
+    }
+    
+    // TX FIFO empty means room for a whole frame (32 bytes deep)
+    while (uart_get_hw(uart_default)->fr & UART_UARTFR_TXFE_BITS) {
+        trace_ring_t *ring = trace_oldest();
+        if (!ring) {
+            dump_requested = false;
+            return false;
+        }
+        trace_send(ring);
+    }
+    return true;
+}
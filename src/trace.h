@@ -0,0 +1,70 @@
+// FILE: src/trace.h
+// Binary trace records in a per-core ring, streamed over the stdio UART from idle time
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "pico/stdlib.h"
+
+#define TRACE_LEVEL_OFF   0
+#define TRACE_LEVEL_ERROR 1
+#define TRACE_LEVEL_INFO  2
+#define TRACE_LEVEL_DEBUG 3   // Per report / per poll, expect drops at 115200 baud
+
+// Records above this level compile to nothing (set from CMakeLists.txt)
+#ifndef TRACE_LEVEL
+#define TRACE_LEVEL TRACE_LEVEL_INFO
+#endif
+
+// Stream records as they come (1), or keep them until a 'T' arrives on the UART (0),
+// then send everything buffered
+#ifndef TRACE_STREAM
+#define TRACE_STREAM 1
+#endif
+
+#define TRACE_RING_RECORDS 256      // Per core, power of two
+#define TRACE_FRAME_START  0x1E     // Precedes every record on the wire, never in printf text
+#define TRACE_FRAME_US     1600     // About one frame at 115200 baud
+
+// Record ids. Append only, tools/trace_decode.py reads the names from here
+typedef enum {
+    TRACE_NONE = 0,
+    TRACE_USB_MOUNT,          // dev_addr << 8 | itf, vid << 16 | pid
+    TRACE_USB_UNMOUNT,        // dev_addr << 8 | itf, slot
+    TRACE_USB_REPORT,         // slot, buttons
+    TRACE_MAPLE_CONDITION,    // buttons/triggers word, sticks word (as sent, active low)
+    TRACE_MAPLE_SEND_AGAIN,   // unit, block
+    TRACE_VMU_BLOCK_WRITE,    // page, block
+    TRACE_VMU_SAVE,           // page, 1 saved / 0 failed / 2 abandoned
+    TRACE_RUMBLE,             // large, small
+    TRACE_LCD_FRAME,          // frame sequence, 0
+    TRACE_COUNT
+} trace_id_t;
+
+// 16 bytes, written to the UART as is (little endian) after TRACE_FRAME_START
+typedef struct {
+    uint16_t id;
+    uint8_t  core;
+    uint8_t  dropped;         // Records lost on this core just before this one, saturating
+    uint32_t time_us;
+    uint32_t arg0;
+    uint32_t arg1;
+} trace_record_t;
+
+#define TRACE(level, id, a, b) do { \
+    if ((level) <= TRACE_LEVEL) trace_record((id), (uint32_t)(a), (uint32_t)(b)); \
+} while (0)
+#define TRACE_ERROR(id, a, b) TRACE(TRACE_LEVEL_ERROR, id, a, b)
+#define TRACE_INFO(id, a, b)  TRACE(TRACE_LEVEL_INFO, id, a, b)
+#define TRACE_DEBUG(id, a, b) TRACE(TRACE_LEVEL_DEBUG, id, a, b)
+
+void trace_init(void);
+
+// Any core, interrupts included. Never blocks or waits on the other core: a full ring
+// drops the record and counts it
+void trace_record(uint16_t id, uint32_t arg0, uint32_t arg1);
+
+// Core 0, from events_wait(). Sends what fits in the UART FIFO without waiting, true if
+// records are left for later
+bool trace_idle(void);
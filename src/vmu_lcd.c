@@ -0,0 +1,176 @@
+/*
+ * VMU screen
+ * Dreamcast controller emulator for Raspberry Pi Pico (RP2040/RP2350)
+ *
+ * Core 1 takes each frame out of the LCD block write and publishes it into
+ * one of two slots, the same way controller snapshots go the other way.
+ * Core 0 only ever draws the newest one, so a game streaming animation
+ * faster than the panel bus can take it just loses frames here instead of
+ * queueing them up. The panel drivers then only send the bands and columns
+ * that changed from the last frame.
+ *
+ * 48x32 doubles to 96x64: the whole SSD1331, centred on the 128 wide
+ * monochrome panels. Each source byte becomes its scaled pixels through a
+ * lookup table rather than bit by bit.
+ */
+
+#include <string.h>
+#include "vmu_lcd.h"
+#include "display.h"
+#include "format.h"
+#include "trace.h"
+#include "ram_copy.h"
+
+#define LCD_SCALE 2
+#define LCD_OUT_WIDTH (VMU_LCD_WIDTH * LCD_SCALE)
+#define LCD_OUT_HEIGHT (VMU_LCD_HEIGHT * LCD_SCALE)
+#define LCD_PAGE_COLORS 8 // pagePalette entries, pages past 8 reuse them
+
+typedef struct {
+    volatile uint32_t seq_begin;
+    uint8_t frame[VMU_LCD_FRAME_BYTES];
+    volatile uint32_t seq_end;
+} lcd_slot_t;
+
+static lcd_slot_t lcd_slots[2];
+static volatile uint32_t lcd_sequence = 0;
+static uint32_t drawn_sequence = 0;
+static uint32_t last_frame_ms = 0;
+static bool seen_frame = false;
+
+// One source byte to 16 panel pixels for blit_1bpp: bit 7 (leftmost) becomes bits 0 and 1
+static uint16_t mono_expand[256];
+
+// One source nibble to 8 RGB565 pixels in the page color, rebuilt when the color changes
+static uint16_t color_expand[16][4 * LCD_SCALE];
+static uint16_t color_expand_ink = 0;
+
+void vmu_lcd_init(void) {
+    for (uint b = 0; b < 256; b++) {
+        uint16_t bits = 0;
+        for (uint p = 0; p < 8; p++) {
+            if (b & (0x80 >> p)) {
+                bits |= 3 << (p * LCD_SCALE);
+            }
+        }
+        mono_expand[b] = bits;
+    }
+    memset(color_expand, 0, sizeof(color_expand));
+}
+
+void __not_in_flash_func(vmu_lcd_publish)(const uint8_t *frame) {
+    uint32_t seq = lcd_sequence + 1;
+    if (seq == 0) seq = 1; // 0 is reserved for "never published"
+    lcd_slot_t *slot = &lcd_slots[seq & 1];
+
+    slot->seq_begin = seq;
+    __dmb();
+    ram_copy_words(slot->frame, frame, VMU_LCD_FRAME_BYTES);
+    __dmb();
+    slot->seq_end = seq;
+    __dmb();
+    lcd_sequence = seq;
+    TRACE_DEBUG(TRACE_LCD_FRAME, seq, 0);
+}
+
+// Newest slot that isn't being written. Core 1 would have to publish twice during the
+// copy to lap it, a frame takes the Dreamcast far longer than that to send
+static bool read_frame(uint8_t *frame, uint32_t *sequence) {
+    uint32_t seq = lcd_sequence;
+    for (int attempt = 0; attempt < 2; attempt++) {
+        const lcd_slot_t *slot = &lcd_slots[(seq + attempt) & 1];
+        uint32_t end = slot->seq_end;
+        __dmb();
+        memcpy(frame, slot->frame, VMU_LCD_FRAME_BYTES);
+        __dmb();
+        if (end != 0 && slot->seq_begin == end) {
+            *sequence = end;
+            return true;
+        }
+    }
+    return false;
+}
+
+static uint16_t page_color(uint8_t page) {
+    // Same RGBA order the root block takes its icon color from (format.c)
+    uint32_t rgba = pagePalette[(page + LCD_PAGE_COLORS - 1) % LCD_PAGE_COLORS];
+    uint8_t r = rgba >> 24, g = rgba >> 16, b = rgba >> 8;
+    return ((r & 0xF8) << 8) | ((g & 0xFC) << 3) | (b >> 3);
+}
+
+static void build_color_expand(uint16_t ink) {
+    for (uint n = 0; n < 16; n++) {
+        for (uint p = 0; p < 4; p++) {
+            uint16_t pixel = (n & (0x8 >> p)) ? ink : 0;
+            for (uint s = 0; s < LCD_SCALE; s++) {
+                color_expand[n][p * LCD_SCALE + s] = pixel;
+            }
+        }
+    }
+    color_expand_ink = ink;
+}
+
+static void draw_mono(const uint8_t *frame, int x) {
+    uint16_t row[VMU_LCD_ROW_BYTES];
+    displayFillRect(0, 0, displayDriver()->width, LCD_OUT_HEIGHT, 0);
+    for (int y = 0; y < VMU_LCD_HEIGHT; y++, frame += VMU_LCD_ROW_BYTES) {
+        for (int i = 0; i < VMU_LCD_ROW_BYTES; i++) {
+            row[i] = mono_expand[frame[i]];
+        }
+        // Stride 0 draws the same source row twice
+        displayBlit1bpp(x, y * LCD_SCALE, LCD_OUT_WIDTH, LCD_SCALE, (const uint8_t *)row, 0, 0xFFFF);
+    }
+}
+
+static void draw_color(const uint8_t *frame, int x, uint8_t page) {
+    uint16_t ink = page_color(page);
+    if (ink != color_expand_ink) {
+        build_color_expand(ink);
+    }
+
+    // Each output row twice over, blit_rgb565 takes them as one 96x2 block
+    uint16_t rows[LCD_SCALE][LCD_OUT_WIDTH];
+    if (displayDriver()->width > LCD_OUT_WIDTH) {
+        displayFillRect(0, 0, displayDriver()->width, LCD_OUT_HEIGHT, 0);
+    }
+    for (int y = 0; y < VMU_LCD_HEIGHT; y++, frame += VMU_LCD_ROW_BYTES) {
+        uint16_t *dst = rows[0];
+        for (int i = 0; i < VMU_LCD_ROW_BYTES; i++, dst += 8 * LCD_SCALE) {
+            memcpy(dst, color_expand[frame[i] >> 4], sizeof(color_expand[0]));
+            memcpy(dst + 4 * LCD_SCALE, color_expand[frame[i] & 0xF], sizeof(color_expand[0]));
+        }
+        for (int s = 1; s < LCD_SCALE; s++) {
+            memcpy(rows[s], rows[0], sizeof(rows[0]));
+        }
+        displayBlitRGB565(x, y * LCD_SCALE, LCD_OUT_WIDTH, LCD_SCALE, &rows[0][0]);
+    }
+}
+
+bool vmu_lcd_render(uint8_t page) {
+    if (lcd_sequence == drawn_sequence) {
+        return false;
+    }
+
+    uint8_t frame[VMU_LCD_FRAME_BYTES] __attribute__((aligned(4)));
+    uint32_t sequence;
+    if (!read_frame(frame, &sequence)) {
+        return false;
+    }
+    drawn_sequence = sequence;
+    last_frame_ms = to_ms_since_boot(get_absolute_time());
+    seen_frame = true;
+
+    const display_driver_t *panel = displayDriver();
+    int x = (panel->width - LCD_OUT_WIDTH) / 2;
+    if (panel->color) {
+        draw_color(frame, x, page);
+    } else {
+        draw_mono(frame, x);
+    }
+    updateDisplay();
+    return true;
+}
+
+bool vmu_lcd_active(void) {
+    return seen_frame && to_ms_since_boot(get_absolute_time()) - last_frame_ms < VMU_LCD_TIMEOUT_MS;
+}
@@ -0,0 +1,29 @@
+// FILE: src/vmu_lcd.h
+// VMU screen (Maple LCD function): frames written by the Dreamcast, drawn 2x on the OLED
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "pico/stdlib.h"
+
+#define VMU_LCD_WIDTH 48
+#define VMU_LCD_HEIGHT 32
+#define VMU_LCD_ROW_BYTES (VMU_LCD_WIDTH / 8)
+#define VMU_LCD_FRAME_BYTES (VMU_LCD_ROW_BYTES * VMU_LCD_HEIGHT)
+#define VMU_LCD_FRAME_WORDS (VMU_LCD_FRAME_BYTES / 4)
+
+// Status screen stays off this long after the last frame
+#define VMU_LCD_TIMEOUT_MS 2000
+
+void vmu_lcd_init(void);
+
+// Core 1 (single writer). Rows top to bottom, bit 7 of each byte is the leftmost pixel
+void vmu_lcd_publish(const uint8_t *frame);
+
+// Core 0. Draws the newest frame if one came in since the last call, frames in between
+// are dropped. Monochrome panels light set pixels, the color panel uses the page's color
+bool vmu_lcd_render(uint8_t page);
+
+// Core 0. A game has drawn to the screen recently
+bool vmu_lcd_active(void);
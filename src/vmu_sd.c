@@ -0,0 +1,118 @@
+/*
+ * SD-backed VMU pages
+ * Dreamcast controller emulator for Raspberry Pi Pico (RP2040/RP2350)
+ *
+ * A page on the SD card is never loaded as a whole. Core 1 can't wait for
+ * the card inside a Maple reply, so it only ever sees what is resident: the
+ * hot and pool blocks in vmu_store.c, and the small window of blocks here.
+ * Anything else is answered with SEND_AGAIN while core 0 fetches it.
+ *
+ * Blocks reach the card through the SD block cache, so a save's worth of
+ * writes goes out in a few coalesced multi-block writes on vmu_sd_sync().
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "vmu_sd.h"
+#include "vmu_store.h"
+#include "fat32.h"
+#include "sd_cache.h"
+
+#define WINDOW_EMPTY 0xFFFF
+
+static fat32_file_t page_file;
+static bool page_open = false;
+
+static volatile uint16_t window_block[VMU_SD_WINDOW_BLOCKS];
+static uint32_t window_used[VMU_SD_WINDOW_BLOCKS];
+static uint32_t window_counter = 0;
+static uint8_t window_data[VMU_SD_WINDOW_BLOCKS][BLOCK_SIZE] __attribute__((aligned(4)));
+
+bool vmu_sd_open(uint8_t page) {
+    page_open = false;
+    if (!fat32_is_mounted()) {
+        return false;
+    }
+
+    char name[13];
+    sprintf(name, "VMU_P%d.BIN", page);
+    if (!fat32_create(name, VMU_PAGE_BYTES, &page_file)) {
+        return false;
+    }
+    page_open = true;
+    return true;
+}
+
+const uint8_t *__not_in_flash_func(vmu_sd_lookup)(uint block) {
+    for (uint i = 0; i < VMU_SD_WINDOW_BLOCKS; i++) {
+        if (window_block[i] == block) {
+            return window_data[i];
+        }
+    }
+    return NULL;
+}
+
+void vmu_sd_reset_window(void) {
+    for (uint i = 0; i < VMU_SD_WINDOW_BLOCKS; i++) {
+        window_block[i] = WINDOW_EMPTY;
+        window_used[i] = 0;
+    }
+}
+
+// Replaces the copy of the block if resident, the least recently installed block otherwise
+void vmu_sd_install(uint block, const uint8_t *data) {
+    uint slot = 0;
+    for (uint i = 0; i < VMU_SD_WINDOW_BLOCKS; i++) {
+        if (window_block[i] == block) {
+            slot = i;
+            break;
+        }
+        if (window_used[i] < window_used[slot]) {
+            slot = i;
+        }
+    }
+    window_block[slot] = WINDOW_EMPTY;
+    memcpy(window_data[slot], data, BLOCK_SIZE);
+    window_used[slot] = ++window_counter;
+    window_block[slot] = block;
+}
+
+bool vmu_sd_load(uint block, uint count, uint8_t *data) {
+    if (!page_open) {
+        return false;
+    }
+    // One block is usually a FAT/directory-cache hit or read-ahead; more go straight to the card
+    if (count == 1) {
+        uint32_t lba = fat32_sector_lba(&page_file, block);
+        if (!lba) {
+            return false; // Past the end of a short image
+        }
+        const uint8_t *cached = sd_cache_read(lba);
+        if (!cached) {
+            return false;
+        }
+        memcpy(data, cached, BLOCK_SIZE);
+        return true;
+    }
+    return fat32_read(&page_file, block, count, data);
+}
+
+bool vmu_sd_store(uint block, const uint8_t *data) {
+    if (!page_open) {
+        return false;
+    }
+    uint32_t lba = fat32_sector_lba(&page_file, block);
+    if (!lba) {
+        return false; // Never the MBR
+    }
+    uint8_t *cached = sd_cache_modify(lba);
+    if (!cached) {
+        return false;
+    }
+    memcpy(cached, data, BLOCK_SIZE);
+    return true;
+}
+
+bool vmu_sd_sync(void) {
+    return sd_cache_flush();
+}
@@ -0,0 +1,32 @@
+// FILE: src/vmu_sd.h
+// VMU pages kept as image files on the SD card, served a block at a time (see vmu_store.c)
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "pico/stdlib.h"
+
+// Pages after the flash ones, VMU_P9.BIN on
+#define VMU_SD_PAGES 8
+
+// Blocks of the current SD page resident in RAM for core 1, besides the hot and pool blocks
+#define VMU_SD_WINDOW_BLOCKS 16
+
+// Blocks fetched after a miss, following the FAT chain of the file it belongs to
+#define VMU_SD_PREFETCH 3
+
+// Core 0. Opens the page's image, creating it if needed. False without a FAT32 card
+bool vmu_sd_open(uint8_t page);
+
+// Resident copy of a block or NULL. Any core, RAM only
+const uint8_t *vmu_sd_lookup(uint block);
+
+// Window changes. The caller keeps core 1 and the Maple TX DMA off the window meanwhile
+void vmu_sd_reset_window(void);
+void vmu_sd_install(uint block, const uint8_t *data);
+
+// Core 0, card I/O through the SD block cache. Stores are written out by vmu_sd_sync()
+bool vmu_sd_load(uint block, uint count, uint8_t *data);
+bool vmu_sd_store(uint block, const uint8_t *data);
+bool vmu_sd_sync(void);
@@ -0,0 +1,768 @@
+/*
+ * VMU store
+ * Dreamcast controller emulator for Raspberry Pi Pico (RP2040/RP2350)
+ *
+ * All 8 VMU pages (and the settings) live in one append-only log. A block is
+ * never rewritten in place: a changed block goes into the next free slot, and
+ * its header entry (sequence number, page, block, CRC32) is programmed after
+ * the data, which makes the entry the commit marker. Power off halfway through
+ * leaves either no entry or one whose CRC doesn't match, and the older copy
+ * wins at the next boot.
+ *
+ * At boot the headers are scanned and the newest valid copy of each block goes
+ * into a RAM index. Sectors are filled round robin, so erases are spread over
+ * the whole region, and the only erase is garbage collection of a sector whose
+ * live blocks have all been moved on, run a step at a time in the background.
+ *
+ * Only the current page's root, FAT and directory blocks are kept in RAM.
+ * Blocks the Dreamcast writes are copied into a small pool until writeback.
+ *
+ * Pages after the flash ones live in image files on the SD card (vmu_sd.c).
+ * They share the hot blocks and the pool; the rest of such a page is read on
+ * demand, core 1 answering SEND_AGAIN until core 0 has fetched the block.
+ *
+ * Core 1 reads and writes blocks, core 0 writes them back. Core 1 runs from
+ * RAM and is never stopped for a flash write: flash_write_begin() sets
+ * flash_busy, and until it is clear again only blocks that have to come out of
+ * XIP are answered with SEND_AGAIN. Core 1 reads and writes under store_lock,
+ * and core 0 takes it for every change to what core 1 sees, so writeback never
+ * sees half a phase or frees a slot that is being written. A pool slot stays
+ * put while its block is programmed and is only freed if core 1 didn't write
+ * to it again meanwhile.
+ */
+
+#include <string.h>
+#include "vmu_store.h"
+#include "maple.h"
+#include "maple_bus.h"
+#include "vmu_sd.h"
+#include "ram_copy.h"
+#include "hardware/flash.h"
+#include "hardware/sync.h"
+
+#define LOG_MAGIC 0x4C554D56 // "VMUL"
+#define LOG_NO_SLOT 0xFFFF
+#define LOG_EMPTY 0xFFFFFFFF
+#define LOG_CONFIG_PAGE VMU_PAGES // Settings are block 0 of one more page
+
+// Slot 0 of every sector. Only the first flash page (256 bytes) is used, each entry is
+// programmed on its own once its data slot is written
+typedef struct {
+    uint32_t seq;   // LOG_EMPTY = slot unused
+    uint16_t page;
+    uint16_t block;
+    uint32_t crc;   // CRC32 of the data, then seq/page/block
+} log_entry_t;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t reserved;
+    log_entry_t entries[VMU_LOG_SLOTS - 1];
+} log_header_t;
+
+typedef enum {
+    SECTOR_ERASED = 0,  // Free and ready
+    SECTOR_UNKNOWN,     // Free, but not a log sector yet (needs an erase before use)
+    SECTOR_IN_USE,
+} sector_state_t;
+
+typedef struct {
+    uint16_t block;   // 0xFFFF = free, dirty or not (see pool_dirty)
+} pool_slot_t;
+
+#define POOL_FREE 0xFFFF
+
+static uint32_t store_offset;
+static uint8_t store_page = 1;
+
+// Held by core 1 for each block access and by core 0 for each change to the RAM side
+static spin_lock_t *store_lock;
+
+// Core 0 is erasing or programming. XIP is gone, core 1 serves only what is in RAM
+static volatile bool flash_busy = false;
+
+// Log state
+static uint16_t block_index[VMU_PAGES + 1][CARD_BLOCKS]; // Slot number (sector * VMU_LOG_SLOTS + slot)
+static uint8_t sector_state[VMU_LOG_SECTORS];
+static uint8_t sector_live[VMU_LOG_SECTORS];
+static uint free_sectors = 0;
+static int write_sector = -1;
+static uint write_slot = VMU_LOG_SLOTS;
+static uint last_opened = VMU_LOG_SECTORS - 1;
+static uint32_t log_seq = 0;
+static volatile bool gc_pending = false;
+
+// SD pages (vmu_sd.c). While loading, core 1 is told to retry everything
+static volatile bool page_on_sd = false;
+static volatile bool page_loading = false;
+static volatile bool sd_unsynced = false; // Blocks in the SD block cache not yet on the card
+
+// Current page in RAM
+static uint8_t hot_blocks[VMU_HOT_BLOCKS][BLOCK_SIZE] __attribute__((aligned(4)));
+static volatile uint16_t hot_dirty = 0;
+static uint8_t pool_blocks[VMU_POOL_BLOCKS][BLOCK_SIZE] __attribute__((aligned(4)));
+static pool_slot_t pool_slots[VMU_POOL_BLOCKS];
+static volatile uint16_t pool_dirty = 0;
+
+// Never-written blocks read as zeros. Not const, core 1 may send it while XIP is gone
+static uint8_t blank_block[BLOCK_SIZE] __attribute__((aligned(4)));
+
+// Block being programmed. XIP is gone while the flash is busy, so everything is staged here first
+static uint8_t stage_block[BLOCK_SIZE] __attribute__((aligned(4)));
+static uint8_t header_page[FLASH_PAGE_SIZE] __attribute__((aligned(4)));
+
+static uint32_t crc_table[256];
+
+static void crc32_init(void) {
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t c = i;
+        for (int k = 0; k < 8; k++) {
+            c = (c & 1) ? (c >> 1) ^ 0xEDB88320 : c >> 1;
+        }
+        crc_table[i] = c;
+    }
+}
+
+static uint32_t crc32_update(uint32_t crc, const uint8_t *data, uint len) {
+    while (len--) {
+        crc = crc_table[(crc ^ *data++) & 0xFF] ^ (crc >> 8);
+    }
+    return crc;
+}
+
+static uint32_t entry_crc(const uint8_t *data, uint32_t seq, uint16_t page, uint16_t block) {
+    uint32_t crc = crc32_update(0xFFFFFFFF, data, BLOCK_SIZE);
+    crc = crc32_update(crc, (const uint8_t *)&seq, sizeof(seq));
+    crc = crc32_update(crc, (const uint8_t *)&page, sizeof(page));
+    crc = crc32_update(crc, (const uint8_t *)&block, sizeof(block));
+    return ~crc;
+}
+
+static __force_inline uint32_t sector_offset(uint sector) {
+    return store_offset + sector * FLASH_SECTOR_SIZE;
+}
+
+static inline const log_header_t *sector_header(uint sector) {
+    return (const log_header_t *)(XIP_BASE + sector_offset(sector));
+}
+
+static __force_inline const uint8_t *slot_data(uint slot) {
+    return (const uint8_t *)(XIP_BASE + sector_offset(slot / VMU_LOG_SLOTS) + (slot % VMU_LOG_SLOTS) * BLOCK_SIZE);
+}
+
+static inline const log_entry_t *slot_entry(uint slot) {
+    return &sector_header(slot / VMU_LOG_SLOTS)->entries[slot % VMU_LOG_SLOTS - 1];
+}
+
+// NULL while the flash is busy, unless the block was never written
+static const uint8_t *__not_in_flash_func(indexed_block)(uint8_t page, uint block) {
+    uint16_t slot = block_index[page][block];
+    if (slot == LOG_NO_SLOT) {
+        return blank_block;
+    }
+    return flash_busy ? NULL : slot_data(slot);
+}
+
+static int __not_in_flash_func(pool_find)(uint block) {
+    for (int i = 0; i < VMU_POOL_BLOCKS; i++) {
+        if (pool_slots[i].block == block) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static void pool_clear(void) {
+    for (int i = 0; i < VMU_POOL_BLOCKS; i++) {
+        pool_slots[i].block = POOL_FREE;
+    }
+    pool_dirty = 0;
+}
+
+// Everything that erases or programs flash goes between these. Once flash_busy is set under
+// the lock core 1 starts no new read out of XIP, and the last one it started is over when the
+// TX DMA is
+static uint32_t flash_write_begin(void) {
+    uint32_t lock = spin_lock_blocking(store_lock);
+    flash_busy = true;
+    spin_unlock(store_lock, lock);
+    while (maple_tx_busy()) {
+        tight_loop_contents();
+    }
+    return save_and_disable_interrupts();
+}
+
+static void flash_write_end(uint32_t interrupts) {
+    restore_interrupts(interrupts);
+    __dmb(); // Index changes are visible before core 1 may follow them into XIP
+    flash_busy = false;
+}
+
+// Core 0 changes to RAM copies core 1 serves. A reply may still be DMA'ing out of one
+static uint32_t store_edit_begin(void) {
+    uint32_t lock = spin_lock_blocking(store_lock);
+    while (maple_tx_busy()) {
+        tight_loop_contents();
+    }
+    return lock;
+}
+
+static void store_edit_end(uint32_t lock) {
+    spin_unlock(store_lock, lock);
+}
+
+// Caller holds flash_write_begin()
+static bool open_sector_locked(void) {
+    for (uint n = 1; n <= VMU_LOG_SECTORS; n++) {
+        uint sector = (last_opened + n) % VMU_LOG_SECTORS;
+        if (sector_state[sector] == SECTOR_IN_USE) continue;
+
+        if (sector_state[sector] == SECTOR_UNKNOWN) {
+            flash_range_erase(sector_offset(sector), FLASH_SECTOR_SIZE);
+        }
+        memset(header_page, 0xFF, sizeof(header_page));
+        ((log_header_t *)header_page)->magic = LOG_MAGIC;
+        flash_range_program(sector_offset(sector), header_page, sizeof(header_page));
+
+        sector_state[sector] = SECTOR_IN_USE;
+        sector_live[sector] = 0;
+        free_sectors--;
+        write_sector = sector;
+        write_slot = 1;
+        last_opened = sector;
+        return true;
+    }
+    return false;
+}
+
+// Caller holds flash_write_begin(), data is in RAM
+static bool append_locked(uint8_t page, uint block, const uint8_t *data) {
+    if (write_sector < 0 || write_slot >= VMU_LOG_SLOTS) {
+        if (!free_sectors || !open_sector_locked()) {
+            return false;
+        }
+    }
+
+    uint slot = write_sector * VMU_LOG_SLOTS + write_slot;
+    flash_range_program(sector_offset(write_sector) + write_slot * BLOCK_SIZE, data, BLOCK_SIZE);
+
+    // Entry last, it is what makes the block count
+    log_entry_t entry = {++log_seq, page, block, 0};
+    entry.crc = entry_crc(data, entry.seq, entry.page, entry.block);
+    memset(header_page, 0xFF, sizeof(header_page));
+    memcpy(&((log_header_t *)header_page)->entries[write_slot - 1], &entry, sizeof(entry));
+    flash_range_program(sector_offset(write_sector), header_page, sizeof(header_page));
+
+    uint16_t old = block_index[page][block];
+    if (old != LOG_NO_SLOT) {
+        sector_live[old / VMU_LOG_SLOTS]--;
+    }
+    block_index[page][block] = slot;
+    sector_live[write_sector]++;
+    write_slot++;
+    return true;
+}
+
+// Fullest-of-garbage sector that isn't being written to, -1 if none is worth collecting
+static int gc_victim(void) {
+    int victim = -1;
+    uint fewest = VMU_LOG_SLOTS - 1;
+    for (uint sector = 0; sector < VMU_LOG_SECTORS; sector++) {
+        if (sector_state[sector] == SECTOR_IN_USE && (int)sector != write_sector && sector_live[sector] < fewest) {
+            fewest = sector_live[sector];
+            victim = sector;
+        }
+    }
+    return victim;
+}
+
+static void update_gc_pending(void) {
+    gc_pending = free_sectors < VMU_LOG_GC_RESERVE && gc_victim() >= 0;
+}
+
+// Caller holds flash_write_begin(). Moves one live block out of the victim, or erases it once empty
+static bool gc_step_locked(void) {
+    int victim = gc_victim();
+    if (victim < 0) {
+        return false;
+    }
+
+    if (sector_live[victim] == 0) {
+        flash_range_erase(sector_offset(victim), FLASH_SECTOR_SIZE);
+        sector_state[victim] = SECTOR_ERASED;
+        free_sectors++;
+        return true;
+    }
+
+    for (uint i = 1; i < VMU_LOG_SLOTS; i++) {
+        uint slot = victim * VMU_LOG_SLOTS + i;
+        const log_entry_t *entry = slot_entry(slot);
+        if (entry->seq == LOG_EMPTY || entry->page > LOG_CONFIG_PAGE || entry->block >= CARD_BLOCKS) continue;
+        if (block_index[entry->page][entry->block] != slot) continue;
+
+        uint8_t page = entry->page;
+        uint block = entry->block;
+        memcpy(stage_block, slot_data(slot), BLOCK_SIZE);
+        return append_locked(page, block, stage_block);
+    }
+    return false;
+}
+
+// Leaves room for at least one more block. A garbage collection step per flash write, so
+// there is never more than one erase without core 1 getting XIP back in between. Uses
+// stage_block, so it goes before anything is staged
+static void make_room(void) {
+    while ((write_sector < 0 || write_slot >= VMU_LOG_SLOTS) && free_sectors < 2) {
+        uint32_t interrupts = flash_write_begin();
+        bool collected = gc_step_locked();
+        flash_write_end(interrupts);
+        if (!collected) break;
+    }
+}
+
+void vmu_store_init(uint32_t flash_offset) {
+    store_offset = flash_offset;
+    store_lock = spin_lock_init(spin_lock_claim_unused(true));
+    crc32_init();
+    memset(block_index, 0xFF, sizeof(block_index));
+    pool_clear();
+
+    uint valid = 0;
+    free_sectors = 0;
+    for (uint sector = 0; sector < VMU_LOG_SECTORS; sector++) {
+        const log_header_t *header = sector_header(sector);
+        if (header->magic != LOG_MAGIC) {
+            // Erased, or something from before the log. Either way free, the latter erased when first used
+            const uint32_t *words = (const uint32_t *)header;
+            sector_state[sector] = SECTOR_ERASED;
+            for (uint i = 0; i < FLASH_SECTOR_SIZE / 4; i++) {
+                if (words[i] != 0xFFFFFFFF) {
+                    sector_state[sector] = SECTOR_UNKNOWN;
+                    break;
+                }
+            }
+            free_sectors++;
+            continue;
+        }
+
+        // Partly filled sectors aren't resumed (a slot may have been half programmed), writing
+        // starts in a fresh one and these are left to garbage collection
+        sector_state[sector] = SECTOR_IN_USE;
+        for (uint i = 1; i < VMU_LOG_SLOTS; i++) {
+            const log_entry_t *entry = &header->entries[i - 1];
+            if (entry->seq == LOG_EMPTY || entry->page > LOG_CONFIG_PAGE || entry->block >= CARD_BLOCKS) continue;
+
+            uint slot = sector * VMU_LOG_SLOTS + i;
+            uint16_t current = block_index[entry->page][entry->block];
+            if (current != LOG_NO_SLOT && (int32_t)(slot_entry(current)->seq - entry->seq) > 0) continue;
+            if (entry_crc(slot_data(slot), entry->seq, entry->page, entry->block) != entry->crc) continue;
+
+            if (current == LOG_NO_SLOT) valid++;
+            block_index[entry->page][entry->block] = slot;
+            if ((int32_t)(entry->seq - log_seq) > 0) log_seq = entry->seq;
+        }
+    }
+
+    memset(sector_live, 0, sizeof(sector_live));
+    for (uint page = 0; page <= LOG_CONFIG_PAGE; page++) {
+        for (uint block = 0; block < CARD_BLOCKS; block++) {
+            if (block_index[page][block] != LOG_NO_SLOT) {
+                sector_live[block_index[page][block] / VMU_LOG_SLOTS]++;
+            }
+        }
+    }
+    update_gc_pending();
+
+    printf("VMU store: %u blocks in log, %u of %u sectors free\n", valid, free_sectors, VMU_LOG_SECTORS);
+}
+
+bool vmu_store_load_config(uint8_t *data, uint len) {
+    if (block_index[LOG_CONFIG_PAGE][0] == LOG_NO_SLOT || len > BLOCK_SIZE) {
+        return false;
+    }
+    memcpy(data, indexed_block(LOG_CONFIG_PAGE, 0), len);
+    return true;
+}
+
+void vmu_store_save_config(const uint8_t *data, uint len) {
+    if (len > BLOCK_SIZE) {
+        return;
+    }
+    // Nothing changed, don't use up a slot
+    if (block_index[LOG_CONFIG_PAGE][0] != LOG_NO_SLOT &&
+        memcmp(indexed_block(LOG_CONFIG_PAGE, 0), data, len) == 0) {
+        return;
+    }
+
+    make_room();
+    uint32_t interrupts = flash_write_begin();
+    memset(stage_block, 0, sizeof(stage_block));
+    memcpy(stage_block, data, len);
+    append_locked(LOG_CONFIG_PAGE, 0, stage_block);
+    flash_write_end(interrupts);
+    update_gc_pending();
+}
+
+// Hot, pool, then the page itself (flash log or SD window). NULL if an SD block isn't resident
+static const uint8_t *__not_in_flash_func(lookup_block)(uint block) {
+    if (block >= VMU_HOT_FIRST_BLOCK) {
+        return hot_blocks[block - VMU_HOT_FIRST_BLOCK];
+    }
+    int slot = pool_find(block);
+    if (slot >= 0) {
+        return pool_blocks[slot];
+    }
+    return page_on_sd ? vmu_sd_lookup(block) : indexed_block(store_page, block);
+}
+
+static uint8_t *__not_in_flash_func(modify_block)(uint block) {
+    if (block >= VMU_HOT_FIRST_BLOCK) {
+        hot_dirty |= 1u << (block - VMU_HOT_FIRST_BLOCK);
+        return hot_blocks[block - VMU_HOT_FIRST_BLOCK];
+    }
+
+    int slot = pool_find(block);
+    if (slot < 0) {
+        // Writes come a phase at a time, start from the current contents
+        const uint8_t *current = page_on_sd ? vmu_sd_lookup(block) : indexed_block(store_page, block);
+        if (!current) {
+            return NULL;
+        }
+        slot = pool_find(POOL_FREE);
+        if (slot < 0) {
+            return NULL;
+        }
+        ram_copy_words(pool_blocks[slot], current, BLOCK_SIZE);
+        pool_slots[slot].block = block;
+    }
+    pool_dirty |= 1u << slot;
+    return pool_blocks[slot];
+}
+
+uint32_t __not_in_flash_func(vmu_store_lock)(void) {
+    return spin_lock_blocking(store_lock);
+}
+
+void __not_in_flash_func(vmu_store_unlock)(uint32_t lock) {
+    spin_unlock(store_lock, lock);
+}
+
+const uint8_t *__not_in_flash_func(vmu_store_read_block)(uint block) {
+    if (block >= CARD_BLOCKS || page_loading) {
+        return NULL;
+    }
+    return lookup_block(block);
+}
+
+uint8_t *__not_in_flash_func(vmu_store_write_block)(uint block) {
+    if (block >= CARD_BLOCKS || page_loading) {
+        return NULL;
+    }
+    return modify_block(block);
+}
+
+bool __not_in_flash_func(vmu_store_block_missing)(uint block) {
+    if (block >= CARD_BLOCKS) {
+        return false;
+    }
+    if (page_loading) {
+        return true;
+    }
+    if (block >= VMU_HOT_FIRST_BLOCK || pool_find(block) >= 0) {
+        return false;
+    }
+    if (page_on_sd) {
+        return !vmu_sd_lookup(block);
+    }
+    return flash_busy && block_index[store_page][block] != LOG_NO_SLOT;
+}
+
+bool __not_in_flash_func(vmu_store_needs_writeback)(void) {
+    return hot_dirty || pool_dirty || gc_pending || sd_unsynced;
+}
+
+uint8_t vmu_store_current_page(void) {
+    return store_page;
+}
+
+// Caller holds store_lock. Copies one dirty block of the current page to stage_block and
+// clears its dirty bit; its pool slot (pool >= 0) stays taken, see settle_dirty_locked()
+static bool take_dirty_locked(uint *block, int *pool) {
+    *pool = -1;
+    if (hot_dirty) {
+        uint hot = __builtin_ctz(hot_dirty);
+        *block = VMU_HOT_FIRST_BLOCK + hot;
+        memcpy(stage_block, hot_blocks[hot], BLOCK_SIZE);
+        hot_dirty &= ~(1u << hot);
+        return true;
+    }
+    if (pool_dirty) {
+        uint i = __builtin_ctz(pool_dirty);
+        *pool = i;
+        *block = pool_slots[i].block;
+        memcpy(stage_block, pool_blocks[i], BLOCK_SIZE);
+        pool_dirty &= ~(1u << i);
+        return true;
+    }
+    return false;
+}
+
+// Caller holds store_lock. After writing back what take_dirty_locked() took: the pool slot is
+// freed unless core 1 wrote to it again meanwhile, a block that wasn't written is dirty again
+static void settle_dirty_locked(uint block, int pool, bool written) {
+    if (!written) {
+        if (pool >= 0) {
+            pool_dirty |= 1u << pool;
+        } else {
+            hot_dirty |= 1u << (block - VMU_HOT_FIRST_BLOCK);
+        }
+    } else if (pool >= 0 && !(pool_dirty & (1u << pool))) {
+        pool_slots[pool].block = POOL_FREE; // Reads go to the new copy in flash from now on
+    }
+}
+
+// Appends one dirty block of the current page, false if none or the log is full
+static bool writeback_block(void) {
+    uint block;
+    int pool;
+    if (!hot_dirty && !pool_dirty) {
+        return false;
+    }
+    make_room();
+
+    uint32_t lock = spin_lock_blocking(store_lock);
+    bool found = take_dirty_locked(&block, &pool);
+    spin_unlock(store_lock, lock);
+    if (!found) {
+        return false;
+    }
+
+    uint32_t interrupts = flash_write_begin();
+    bool written = append_locked(store_page, block, stage_block); // Log full: stays dirty, nothing is lost
+    flash_write_end(interrupts);
+
+    lock = spin_lock_blocking(store_lock);
+    settle_dirty_locked(block, pool, written);
+    spin_unlock(store_lock, lock);
+    return written;
+}
+
+// SD page: one dirty block into the SD block cache. The card itself is written by sd_sync().
+// False if there was none, or it couldn't be stored (card gone, page file closed)
+static bool sd_writeback_block(void) {
+    uint block;
+    int pool;
+    uint32_t lock = store_edit_begin();
+    bool found = take_dirty_locked(&block, &pool);
+    if (found && pool >= 0) {
+        // Stays resident in the window once it leaves the pool
+        vmu_sd_install(block, stage_block);
+        pool_slots[pool].block = POOL_FREE;
+    }
+    store_edit_end(lock);
+
+    if (found) {
+        if (vmu_sd_store(block, stage_block)) {
+            sd_unsynced = true;
+        } else {
+            // Dirty again, from the copy just installed
+            lock = spin_lock_blocking(store_lock);
+            modify_block(block);
+            spin_unlock(store_lock, lock);
+            return false;
+        }
+    }
+    return found;
+}
+
+static void sd_sync(void) {
+    if (sd_unsynced) {
+        // On failure the blocks stay dirty in the SD block cache and go with the next sync,
+        // still asked for by vmu_store_needs_writeback()
+        if (vmu_sd_sync()) {
+            sd_unsynced = false;
+        } else {
+            printf("VMU page %d: SD write failed\n", store_page);
+        }
+    }
+}
+
+bool vmu_store_writeback_step(void) {
+    if (page_on_sd) {
+        if (!sd_writeback_block()) {
+            sd_sync();
+        }
+        return vmu_store_needs_writeback();
+    }
+
+    // Collect garbage before it is needed, otherwise a long save could find no free sector
+    bool collected = false;
+    if (gc_pending) {
+        uint32_t interrupts = flash_write_begin();
+        collected = gc_step_locked();
+        flash_write_end(interrupts);
+    }
+    if (!collected) {
+        writeback_block();
+    }
+    update_gc_pending();
+    return vmu_store_needs_writeback();
+}
+
+void vmu_store_flush(void) {
+    uint blocks = 0;
+    if (page_on_sd) {
+        while (sd_writeback_block()) {
+            blocks++;
+        }
+        sd_sync();
+    } else {
+        // A flash write at a time, core 1 serves whatever is in XIP in between
+        while (writeback_block()) {
+            blocks++;
+        }
+        update_gc_pending();
+    }
+    if (blocks) {
+        printf("VMU page %d: %u blocks written to %s\n", store_page, blocks, page_on_sd ? "SD" : "flash");
+    }
+}
+
+void vmu_store_fetch(uint block) {
+    const uint16_t *fat = (const uint16_t *)hot_blocks[FAT_BLOCK - VMU_HOT_FIRST_BLOCK];
+
+    // Games read a file front to back, so the next few blocks of its FAT chain come along
+    for (uint n = 0; n <= VMU_SD_PREFETCH; n++) {
+        if (!page_on_sd || page_loading || block >= VMU_HOT_FIRST_BLOCK) {
+            break;
+        }
+        if (vmu_store_block_missing(block)) {
+            if (!vmu_sd_load(block, 1, stage_block)) {
+                printf("VMU page %d: can't read block %u from SD\n", store_page, block);
+                break;
+            }
+            uint32_t lock = store_edit_begin();
+            vmu_sd_install(block, stage_block);
+            store_edit_end(lock);
+        }
+        block = fat[block]; // End of file and free markers are past CARD_BLOCKS
+    }
+}
+
+// Formatting an SD page reads and writes blocks core 1 hasn't asked for. Core 1 is held off by
+// page_loading meanwhile, so they are read in directly
+static void format_fetch(uint32_t block) {
+    if (page_on_sd && block < VMU_HOT_FIRST_BLOCK && pool_find(block) < 0 && !vmu_sd_lookup(block)) {
+        if (!vmu_sd_load(block, 1, stage_block)) {
+            memset(stage_block, 0, BLOCK_SIZE);
+        }
+        vmu_sd_install(block, stage_block);
+    }
+}
+
+static uint8_t *format_write_block(uint32_t block) {
+    format_fetch(block);
+    return modify_block(block);
+}
+
+static const uint8_t *format_read_block(uint32_t block) {
+    format_fetch(block);
+    return lookup_block(block);
+}
+
+void vmu_store_select_page(uint8_t page) {
+    if (page < 1 || page > VMU_PAGES + VMU_SD_PAGES) page = 1;
+
+    // Pool and hot blocks belong to the old page
+    vmu_store_flush();
+
+    bool on_sd = page > VMU_PAGES;
+    if (on_sd && !vmu_sd_open(page)) {
+        printf("VMU page %d: no image on SD, using page 1\n", page);
+        page = 1;
+        on_sd = false;
+    }
+
+    uint32_t lock = store_edit_begin();
+    store_page = page;
+    page_on_sd = on_sd;
+    pool_clear();
+    hot_dirty = 0;
+    if (!on_sd) {
+        page_loading = false;
+        for (uint i = 0; i < VMU_HOT_BLOCKS; i++) {
+            memcpy(hot_blocks[i], indexed_block(page, VMU_HOT_FIRST_BLOCK + i), BLOCK_SIZE);
+        }
+        // A page that was never used gets a fresh filesystem, written back like any other change
+        CheckFormatted(format_read_block, format_write_block, page);
+        store_edit_end(lock);
+        return;
+    }
+
+    // The card is far too slow to read with the store locked. Core 1 answers SEND_AGAIN until the
+    // page is in instead; only the hot blocks are read now, the rest on demand
+    page_loading = true;
+    vmu_sd_reset_window();
+    store_edit_end(lock);
+
+    if (!vmu_sd_load(VMU_HOT_FIRST_BLOCK, VMU_HOT_BLOCKS, hot_blocks[0])) {
+        printf("VMU page %d: can't read from SD, using page 1\n", page);
+        vmu_store_select_page(1);
+        return;
+    }
+    // Palette has one colour per flash page, SD pages reuse them
+    CheckFormatted(format_read_block, format_write_block, (page - 1) % VMU_PAGES + 1);
+    __dmb();
+    page_loading = false;
+}
+
+bool vmu_store_restore_blocks(uint8_t page, uint first, uint count, const uint8_t *data) {
+    if (page < 1 || page > VMU_PAGES || first + count > CARD_BLOCKS) {
+        return false;
+    }
+
+    uint done = 0;
+    while (done < count) {
+        make_room();
+
+        // As many as fit without a second sector being opened (and maybe erased) or garbage
+        // collection being needed
+        uint start = done;
+        int sector = write_sector;
+        bool ok = true;
+        uint32_t interrupts = flash_write_begin();
+        while (done < count) {
+            if (done > start && (write_sector < 0 || write_slot >= VMU_LOG_SLOTS) &&
+                (write_sector != sector || free_sectors < 2)) {
+                break;
+            }
+            ok = append_locked(page, first + done, &data[done * BLOCK_SIZE]);
+            if (!ok) break;
+            done++;
+        }
+        flash_write_end(interrupts);
+
+        if (page == store_page && done > start) {
+            // Drop anything pending for the blocks and keep the RAM copies in step
+            uint32_t lock = store_edit_begin();
+            for (uint i = start; i < done; i++) {
+                uint block = first + i;
+                int slot = pool_find(block);
+                if (slot >= 0) {
+                    pool_slots[slot].block = POOL_FREE;
+                    pool_dirty &= ~(1u << slot);
+                }
+                if (block >= VMU_HOT_FIRST_BLOCK) {
+                    memcpy(hot_blocks[block - VMU_HOT_FIRST_BLOCK], &data[i * BLOCK_SIZE], BLOCK_SIZE);
+                    hot_dirty &= ~(1u << (block - VMU_HOT_FIRST_BLOCK));
+                }
+            }
+            store_edit_end(lock);
+        }
+        if (!ok) {
+            break;
+        }
+    }
+    update_gc_pending();
+    return done == count;
+}
@@ -0,0 +1,76 @@
+// FILE: src/vmu_store.h
+// VMU pages and settings in a log-structured, wear-levelled flash store
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "pico/stdlib.h"
+#include "format.h"
+
+#define VMU_PAGES 8
+#define VMU_PAGE_BYTES (CARD_BLOCKS * BLOCK_SIZE)            // 128KB
+
+// Log layout: every 4KB sector is a header slot followed by 7 data slots of one block each.
+// 384 sectors hold 2688 blocks for at most 2049 live ones (8 full cards + settings), the
+// rest is room for garbage collection.
+#define VMU_LOG_SECTORS 384
+#define VMU_LOG_SLOTS (FLASH_SECTOR_SIZE / BLOCK_SIZE)        // Slot 0 is the header
+#define VMU_STORE_BYTES (VMU_LOG_SECTORS * FLASH_SECTOR_SIZE) // 1.5MB
+
+// Garbage collection starts when fewer sectors than this are free
+#define VMU_LOG_GC_RESERVE 8
+
+// Root, FAT and directory are touched by every save and every file listing, keep them in RAM
+#define VMU_HOT_FIRST_BLOCK (DIRECTORY_BLOCK - NUM_DIRECTORY_BLOCKS + 1)
+#define VMU_HOT_BLOCKS (CARD_BLOCKS - VMU_HOT_FIRST_BLOCK)
+
+// Other blocks written since the last writeback wait here. Full = writes answered with SEND_AGAIN
+#define VMU_POOL_BLOCKS 16
+
+// Core 0. Scans the log at flash_offset and rebuilds the block index
+void vmu_store_init(uint32_t flash_offset);
+
+// Core 0. Settings are a record in the same log, so they are wear-levelled too.
+// Load returns false if none has been saved yet
+bool vmu_store_load_config(uint8_t *data, uint len);
+void vmu_store_save_config(const uint8_t *data, uint len);
+
+// Core 0. Writes back the current page then switches (page is 1-based like currentPage).
+// Pages past VMU_PAGES are image files on the SD card (see vmu_sd.h)
+void vmu_store_select_page(uint8_t page);
+uint8_t vmu_store_current_page(void);
+
+// Core 1 holds this from a block lookup until the TX DMA has started on the block, or until
+// it has finished writing to it, so a writeback can't move, erase or reuse it in between
+uint32_t vmu_store_lock(void);
+void vmu_store_unlock(uint32_t lock);
+
+// Block contents for reading: RAM if cached or written, XIP flash otherwise. Word aligned.
+// NULL if out of range, or not available right now (see vmu_store_block_missing())
+const uint8_t *vmu_store_read_block(uint block);
+
+// RAM copy of the block to modify, NULL if the block is out of range, not available right now
+// or the pool is full
+uint8_t *vmu_store_write_block(uint block);
+
+// True if a NULL from the above only means "ask again": the block is only in XIP and core 0
+// is writing flash, or it is on the SD card and core 0 has to vmu_store_fetch() it
+bool vmu_store_block_missing(uint block);
+
+// Core 0. Reads a missing block of an SD page (and a few after it) into RAM
+void vmu_store_fetch(uint block);
+
+// Dirty blocks, garbage collection or SD writes waiting. Cheap, core 1 checks it every poll
+bool vmu_store_needs_writeback(void);
+
+// Core 0. One step: append a dirty block, move a live block out of the GC victim, or
+// erase it. Returns true if there is more to do
+bool vmu_store_writeback_step(void);
+
+// Core 0. Every dirty block of the current page
+void vmu_store_flush(void);
+
+// Core 0. Replaces count blocks of any page from first on (SD restore), data in RAM. Appended
+// several per flash write; false if the log filled up, the blocks before that are in
+bool vmu_store_restore_blocks(uint8_t page, uint first, uint count, const uint8_t *data);
@@ -1,6 +1,6 @@
 /*
  * Xbox 360 Controller USB Host Integration - Fixed API Version
- * Compatible with Pico SDK v1.5.1 TinyUSB
+ * Compatible with Pico SDK 2.x TinyUSB (application host class drivers)
  */
 
 #include <string.h>
@@ -8,10 +8,40 @@
 #include <stdlib.h>  // Add this for abs() function
 #include "xbox360_usb.h"
 #include "maple.h"    // Include maple.h for dreamcast_state_t definition
+#include "trace.h"
+#include "latency.h"
 
-// Global controller state
-xbox360_controller_t xbox_controller = {0};
-static dreamcast_state_t dc_state_storage = {0};  // Static storage for the state
+// Controller table, a slot per pad
+xbox360_controller_t xbox_controllers[XBOX360_MAX_PADS] = {0};
+static dreamcast_state_t dc_state_storage[XBOX360_MAX_PADS] = {0};  // Static storage for the states
+
+// Published state for the Maple core. Two slots, the writer always fills the one that isn't
+// live. Each slot carries the sequence it was written for at both ends (seqlock): the writer
+// stores begin, data, end and the reader loads end, data, begin, so equal values mean the
+// copy wasn't torn. One pair per pad, a Maple port only ever looks at its own
+typedef struct {
+    volatile uint32_t seq_begin;
+    dreamcast_state_t state;
+    uint32_t timestamp_us;
+    volatile uint32_t seq_end;
+} snapshot_slot_t;
+
+static snapshot_slot_t snapshot_slots[XBOX360_MAX_PADS][2];
+static volatile uint32_t snapshot_sequence[XBOX360_MAX_PADS];
+
+static const dreamcast_state_t neutral_state = {0, 0, 0, 0x80, 0x80};
+
+static void xbox360_publish_snapshot(uint8_t slot, const dreamcast_state_t* state, uint32_t timestamp_us);
+
+// Wireless receiver packets, on each pad's interface:
+//   08 80                  pad linked (08 00 gone, 0x40 is a headset)
+//   00 01 00 f0 00 13 ...  input report, the wired layout from byte 4
+//   00 00 00 13 nn ...     status, nn = battery level
+#define XBOX360W_MSG_PRESENCE    0x08
+#define XBOX360W_PRESENCE_PAD    0x80
+#define XBOX360W_INPUT           0x01
+#define XBOX360W_REPORT_OFFSET   4
+#define XBOX360W_STATUS_LEN      0x13
 
 // Deadzone settings (configurable)
 #define STICK_DEADZONE_THRESHOLD 8000    // Out of 32767
@@ -20,9 +50,12 @@ static dreamcast_state_t dc_state_storage = {0};  // Static storage for the stat
 bool xbox360_init(void) {
     printf("Initializing Xbox 360 Controller USB Host...\n");
     
-    // Initialize USB controller state
-    memset(&xbox_controller, 0, sizeof(xbox_controller));
-    xbox_controller.dc_state = &dc_state_storage;  // Point to static storage
+    // Initialize USB controller state, neutral pads until a controller says otherwise
+    memset(xbox_controllers, 0, sizeof(xbox_controllers));
+    for (uint8_t slot = 0; slot < XBOX360_MAX_PADS; slot++) {
+        xbox_controllers[slot].dc_state = &dc_state_storage[slot];  // Point to static storage
+        xbox360_publish_snapshot(slot, &neutral_state, time_us_32());
+    }
     
     // Initialize TinyUSB host stack
     if (!tusb_init()) {
@@ -35,78 +68,195 @@ bool xbox360_init(void) {
 }
 
 void xbox360_task(void) {
-    // Service TinyUSB host stack
+    // Service TinyUSB host stack. State is mapped and published from the report callback
     tuh_task();
+}
+
+bool xbox360_is_connected(uint8_t slot) {
+    return slot < XBOX360_MAX_PADS && xbox_controllers[slot].connected && xbox_controllers[slot].ready;
+}
+
+bool xbox360_set_rumble(uint8_t slot, uint8_t large, uint8_t small) {
+    if (!xbox360_is_connected(slot)) {
+        return false;
+    }
+    return xinput_set_rumble(xbox_controllers[slot].dev_addr, xbox_controllers[slot].instance, large, small);
+}
+
+dreamcast_state_t* xbox360_get_dreamcast_state(uint8_t slot) {
+    return slot < XBOX360_MAX_PADS ? xbox_controllers[slot].dc_state : NULL;
+}
+
+// Core 0 only (single writer)
+static void xbox360_publish_snapshot(uint8_t slot, const dreamcast_state_t* state, uint32_t timestamp_us) {
+    uint32_t seq = snapshot_sequence[slot] + 1;
+    if (seq == 0) seq = 1; // 0 is reserved for "never published"
+    snapshot_slot_t* entry = &snapshot_slots[slot][seq & 1];
     
-    // Update Dreamcast state if controller is connected
-    if (xbox_controller.connected && xbox_controller.ready) {
-        xbox360_update_dreamcast_mapping();
+    entry->seq_begin = seq;
+    __dmb();
+    entry->state = *state;
+    entry->timestamp_us = timestamp_us;
+    __dmb();
+    entry->seq_end = seq;
+    __dmb();
+    snapshot_sequence[slot] = seq;
+}
+
+uint32_t __not_in_flash_func(xbox360_snapshot_sequence)(uint8_t slot) {
+    return snapshot_sequence[slot];
+}
+
+// Wait-free: at most two slot reads. A copy is only torn if the writer lapped this slot
+// during it, which takes two publishes inside a few hundred nanoseconds; the other slot
+// is then the fresher one anyway
+bool __not_in_flash_func(xbox360_read_snapshot)(uint8_t slot, dreamcast_snapshot_t* snapshot) {
+    uint32_t seq = snapshot_sequence[slot];
+    for (int attempt = 0; attempt < 2; attempt++) {
+        const snapshot_slot_t* entry = &snapshot_slots[slot][(seq + attempt) & 1];
+        uint32_t end = entry->seq_end;
+        __dmb();
+        dreamcast_state_t state = entry->state;
+        uint32_t timestamp_us = entry->timestamp_us;
+        __dmb();
+        if (end != 0 && entry->seq_begin == end) {
+            snapshot->state = state;
+            snapshot->timestamp_us = timestamp_us;
+            snapshot->sequence = end;
+            return true;
+        }
     }
+    return false;
 }
 
-bool xbox360_is_connected(void) {
-    return xbox_controller.connected && xbox_controller.ready;
+static int xbox360_find_slot(uint8_t dev_addr, uint8_t itf_num) {
+    for (int slot = 0; slot < XBOX360_MAX_PADS; slot++) {
+        xbox360_controller_t* pad = &xbox_controllers[slot];
+        if (pad->attached && pad->dev_addr == dev_addr && pad->instance == itf_num) {
+            return slot;
+        }
+    }
+    return -1;
 }
 
-dreamcast_state_t* xbox360_get_dreamcast_state(void) {
-    return xbox_controller.dc_state;
+// Pad gone (unplugged, or unlinked from the receiver). Don't leave its last buttons held
+// on the Dreamcast side
+static void xbox360_pad_lost(uint8_t slot) {
+    xbox360_controller_t* pad = &xbox_controllers[slot];
+    pad->connected = false;
+    pad->ready = false;
+    pad->battery = 0;
+    *pad->dc_state = neutral_state;
+    xbox360_publish_snapshot(slot, &neutral_state, time_us_32());
 }
 
-// USB HID mount callback - called when Xbox 360 controller is connected
-void tuh_hid_mount_cb(uint8_t dev_addr, uint8_t instance, uint8_t const* desc_report, uint16_t desc_len) {
-    printf("HID device mounted: dev_addr=%d, instance=%d\n", dev_addr, instance);
-    
-    // For now, assume any HID device could be an Xbox 360 controller
-    // In a more robust implementation, you'd parse the HID report descriptor
-    // or use other methods to identify the device
+// XInput interface configured, its IN endpoint is already being polled. Takes the first
+// free slot, so a receiver's four pads land on ports A-D in the receiver's own order
+void xinput_mount_cb(uint8_t dev_addr, uint8_t itf_num, uint8_t protocol) {
+    uint16_t vid = 0, pid = 0;
+    tuh_vid_pid_get(dev_addr, &vid, &pid);
+    printf("XInput interface mounted: dev_addr=%d, itf=%d, %04x:%04x\n", dev_addr, itf_num, vid, pid);
+    TRACE_INFO(TRACE_USB_MOUNT, dev_addr << 8 | itf_num, vid << 16 | pid);
     
-    printf("Assuming Xbox 360 Controller detected!\n");
+    int slot = -1;
+    for (int i = 0; i < XBOX360_MAX_PADS; i++) {
+        if (!xbox_controllers[i].attached) {
+            slot = i;
+            break;
+        }
+    }
+    if (slot < 0) {
+        printf("No free pad slot, ignoring it\n");
+        return;
+    }
     
-    xbox_controller.connected = true;
-    xbox_controller.dev_addr = dev_addr;
-    xbox_controller.instance = instance;
-    xbox_controller.vid = XBOX360_VID_MICROSOFT;
-    xbox_controller.pid = XBOX360_PID_CONTROLLER;
+    xbox360_controller_t* pad = &xbox_controllers[slot];
+    pad->attached = true;
+    pad->wireless = protocol == XINPUT_PROTOCOL_WIRELESS;
+    pad->dev_addr = dev_addr;
+    pad->instance = itf_num;
+    pad->vid = vid;
+    pad->pid = pid;
     
-    // Request to receive reports
-    if (tuh_hid_receive_report(dev_addr, instance)) {
-        xbox_controller.ready = true;
-        printf("Xbox 360 Controller ready for input\n");
+    // Wireless ports wait for their pad to link
+    if (!pad->wireless) {
+        pad->connected = true;
+        pad->ready = true;
+        xinput_set_led(dev_addr, itf_num, XINPUT_LED_PLAYER1 + slot);
+        printf("Xbox 360 Controller ready for input on port %c\n", 'A' + slot);
     }
 }
 
-// USB HID unmount callback - called when controller is disconnected
-void tuh_hid_umount_cb(uint8_t dev_addr, uint8_t instance) {
-    printf("HID device unmounted: dev_addr=%d, instance=%d\n", dev_addr, instance);
+void xinput_umount_cb(uint8_t dev_addr, uint8_t itf_num) {
+    printf("XInput interface unmounted: dev_addr=%d, itf=%d\n", dev_addr, itf_num);
     
-    if (xbox_controller.dev_addr == dev_addr && xbox_controller.instance == instance) {
-        printf("Xbox 360 Controller disconnected\n");
-        memset(&xbox_controller, 0, sizeof(xbox_controller));
+    int slot = xbox360_find_slot(dev_addr, itf_num);
+    TRACE_INFO(TRACE_USB_UNMOUNT, dev_addr << 8 | itf_num, slot);
+    if (slot >= 0) {
+        printf("Xbox 360 Controller on port %c disconnected\n", 'A' + slot);
+        xbox360_pad_lost(slot);
+        xbox_controllers[slot].attached = false;
     }
 }
 
-// USB HID report received callback - called when controller sends input data
-void tuh_hid_report_received_cb(uint8_t dev_addr, uint8_t instance, uint8_t const* report, uint16_t len) {
-    if (xbox_controller.dev_addr == dev_addr && xbox_controller.instance == instance) {
-        
-        // Verify report size (minimum for Xbox 360 controller)
-        if (len >= 20) {  // Xbox 360 controller reports are typically 20 bytes
-            
-            // Copy report data (simplified - real Xbox 360 parsing would be more complex)
-            memcpy(&xbox_controller.last_report, report, sizeof(xbox360_report_t));
-            xbox_controller.last_report_time = time_us_32();
-            
-            // Update Dreamcast state
-            xbox360_update_dreamcast_mapping();
-            
-            printf("Xbox360 report: len=%d\n", len);
+static void xbox360_wireless_packet(uint8_t slot, const uint8_t* data, uint16_t len) {
+    xbox360_controller_t* pad = &xbox_controllers[slot];
+    if (len < 2) {
+        return;
+    }
+    
+    if (data[0] == XBOX360W_MSG_PRESENCE) {
+        bool present = data[1] & XBOX360W_PRESENCE_PAD;
+        if (present && !pad->connected) {
+            pad->connected = true;
+            pad->ready = true;
+            xinput_set_led(pad->dev_addr, pad->instance, XINPUT_LED_PLAYER1 + slot);
+            printf("Wireless pad linked on port %c\n", 'A' + slot);
+        } else if (!present && pad->connected) {
+            printf("Wireless pad on port %c gone\n", 'A' + slot);
+            xbox360_pad_lost(slot);
         }
-        
-        // Continue receiving reports
-        tuh_hid_receive_report(dev_addr, instance);
+        return;
+    }
+    
+    if (data[0] == 0x00 && data[1] == XBOX360W_INPUT &&
+        len >= XBOX360W_REPORT_OFFSET + sizeof(xbox360_report_t) &&
+        data[XBOX360W_REPORT_OFFSET] == XINPUT_REPORT_INPUT) {
+        // Input means a pad is there, even if its link packet went missing
+        pad->connected = true;
+        pad->ready = true;
+        pad->last_report_time = time_us_32();
+        xbox360_update_dreamcast_mapping(slot, (const xbox360_report_t*)&data[XBOX360W_REPORT_OFFSET]);
+        TRACE_DEBUG(TRACE_USB_REPORT, slot, ((const xbox360_report_t*)&data[XBOX360W_REPORT_OFFSET])->buttons);
+        return;
+    }
+    
+    if (len >= 5 && data[0] == 0x00 && data[1] == 0x00 && data[3] == XBOX360W_STATUS_LEN) {
+        pad->battery = data[4];
     }
 }
 
+// Every IN transfer. Pads also send other messages (LED status, headset), only input
+// reports carry the pad state
+void xinput_report_cb(uint8_t dev_addr, uint8_t itf_num, const uint8_t* report, uint16_t len) {
+    int slot = xbox360_find_slot(dev_addr, itf_num);
+    if (slot < 0) {
+        return;
+    }
+    if (xbox_controllers[slot].wireless) {
+        xbox360_wireless_packet(slot, report, len);
+        return;
+    }
+    if (len < XINPUT_REPORT_INPUT_LEN || report[0] != XINPUT_REPORT_INPUT ||
+        report[1] != XINPUT_REPORT_INPUT_LEN) {
+        return;
+    }
+    
+    xbox_controllers[slot].last_report_time = time_us_32();
+    xbox360_update_dreamcast_mapping(slot, (const xbox360_report_t*)report);
+    TRACE_DEBUG(TRACE_USB_REPORT, slot, ((const xbox360_report_t*)report)->buttons);
+}
+
 // Convert Xbox 360 button layout to Dreamcast controller layout
 uint16_t xbox360_to_dreamcast_buttons(uint16_t xbox_buttons) {
     uint16_t dc_buttons = 0;
@@ -175,13 +325,13 @@ void xbox360_calibrate_triggers(uint8_t* left_trigger, uint8_t* right_trigger) {
 }
 
 // Update Dreamcast controller state from Xbox 360 input
-void xbox360_update_dreamcast_mapping(void) {
-    if (!xbox_controller.connected || !xbox_controller.ready || !xbox_controller.dc_state) {
+void xbox360_update_dreamcast_mapping(uint8_t slot, const xbox360_report_t* report) {
+    xbox360_controller_t* pad = &xbox_controllers[slot];
+    if (!pad->connected || !pad->ready || !pad->dc_state) {
         return;
     }
     
-    xbox360_report_t* report = &xbox_controller.last_report;
-    dreamcast_state_t* dc_state = xbox_controller.dc_state;
+    dreamcast_state_t* dc_state = pad->dc_state;
     
     // Map buttons
     dc_state->buttons = xbox360_to_dreamcast_buttons(report->buttons);
@@ -193,4 +343,8 @@ void xbox360_update_dreamcast_mapping(void) {
     // Map analog stick (left stick only for basic Dreamcast controller)
     dc_state->stick_x = xbox360_to_dreamcast_stick(report->left_stick_x);
     dc_state->stick_y = xbox360_to_dreamcast_stick(report->left_stick_y);
+    
+    // The Maple core picks this up and patches its GetCondition reply before the next poll
+    xbox360_publish_snapshot(slot, dc_state, pad->last_report_time);
+    latency_report_mapped(pad->last_report_time);
 }
\ No newline at end of file
@@ -13,7 +13,7 @@
 #include "pico/stdlib.h"
 #include "tusb.h"
 #include "host/usbh.h"
-#include "class/hid/hid_host.h"
+#include "xinput_host.h"
 
 // Xbox 360 Controller USB identifiers
 #define XBOX360_VID_MICROSOFT    0x045E
@@ -21,7 +21,10 @@
 #define XBOX360_PID_WIRELESS     0x0719
 #define XBOX360_PID_CHATPAD      0x0291
 
-// Xbox 360 button mappings (USB HID format)
+// Pads driven at once, slot n feeds Maple port n (A-D)
+#define XBOX360_MAX_PADS         4
+
+// Xbox 360 button mappings (XInput report)
 #define XBOX360_BTN_DPAD_UP      0x0001
 #define XBOX360_BTN_DPAD_DOWN    0x0002
 #define XBOX360_BTN_DPAD_LEFT    0x0004
@@ -52,7 +55,7 @@
 #define DC_BTN_X             0x0400
 #define DC_BTN_D             0x0800
 
-// Xbox 360 Controller input report structure
+// Xbox 360 Controller input report structure, read in place from the XInput IN buffer
 typedef struct {
     uint8_t  report_id;
     uint8_t  report_size;
@@ -68,34 +71,43 @@ typedef struct {
 // Forward declaration - dreamcast_state_t is defined in maple.h
 struct dreamcast_state_s;
 typedef struct dreamcast_state_s dreamcast_state_t;
+struct dreamcast_snapshot_s;
+typedef struct dreamcast_snapshot_s dreamcast_snapshot_t;
 
-// USB Host controller state
+// USB Host controller state, one per slot
 typedef struct {
-    bool     connected;
+    bool     attached;       // Slot taken by an XInput interface (a wired pad, or a receiver port)
+    bool     connected;      // A pad is there: always for wired, once linked for wireless
     bool     ready;
+    bool     wireless;
     uint8_t  dev_addr;
-    uint8_t  instance;
+    uint8_t  instance;       // XInput interface number
+    uint8_t  battery;        // Wireless only, as the receiver reports it
     uint16_t vid;
     uint16_t pid;
-    xbox360_report_t last_report;
     dreamcast_state_t* dc_state;  // Use pointer instead of embedded struct
     uint32_t last_report_time;
 } xbox360_controller_t;
 
-// Global controller state
-extern xbox360_controller_t xbox_controller;
+// Global controller table
+extern xbox360_controller_t xbox_controllers[XBOX360_MAX_PADS];
 
 // Function prototypes
 bool xbox360_init(void);
 void xbox360_task(void);
-bool xbox360_is_connected(void);
-dreamcast_state_t* xbox360_get_dreamcast_state(void);
-void xbox360_update_dreamcast_mapping(void);
-
-// USB Host callbacks
-void tuh_hid_mount_cb(uint8_t dev_addr, uint8_t instance, uint8_t const* desc_report, uint16_t desc_len);
-void tuh_hid_umount_cb(uint8_t dev_addr, uint8_t instance);
-void tuh_hid_report_received_cb(uint8_t dev_addr, uint8_t instance, uint8_t const* report, uint16_t len);
+bool xbox360_is_connected(uint8_t slot);
+dreamcast_state_t* xbox360_get_dreamcast_state(uint8_t slot);
+void xbox360_update_dreamcast_mapping(uint8_t slot, const xbox360_report_t* report);
+
+// Consistent copy of a slot's latest published state. Safe from the other core, never
+// blocks; returns false (snapshot untouched) if a publish raced the copy twice
+bool xbox360_read_snapshot(uint8_t slot, dreamcast_snapshot_t* snapshot);
+uint32_t xbox360_snapshot_sequence(uint8_t slot);
+
+// Core 0. Sets the slot's motors; false if there is no pad or its OUT endpoint is busy
+bool xbox360_set_rumble(uint8_t slot, uint8_t large, uint8_t small);
+
+// USB Host callbacks come from the XInput driver (xinput_host.h)
 
 // Button mapping functions
 uint16_t xbox360_to_dreamcast_buttons(uint16_t xbox_buttons);
@@ -0,0 +1,252 @@
+/*
+ * XInput USB Host Class Driver
+ *
+ * Wired 360 pads (045E:028E) are vendor class, so the HID host never sees
+ * them. This claims the XInput control interface, opens its interrupt IN
+ * and OUT endpoints and keeps an IN transfer queued at all times: the next
+ * one is submitted from the completion callback, into the other buffer,
+ * before the finished report is handed on. The host controller then polls
+ * the pad at its bInterval (4ms, 1ms on some pads) with no gap in between.
+ *
+ * The wireless receiver shows up as one such interface per pad (protocol
+ * 0x81, wrapped packets, see xbox360_usb.c), each with its own endpoints
+ * polled by the hardware. A fourth pad costs no more than the first.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "xinput_host.h"
+#include "host/usbh.h"
+#include "host/usbh_pvt.h"
+
+#define XINPUT_MSG_LED           0x01   // Wired: 01 03 pattern
+#define XINPUT_MSG_RUMBLE        0x00   // Wired: 00 08 00 large small 00 00 00
+#define XINPUT_WIRELESS_MSG_LEN  12     // Receiver messages are always 12 bytes
+
+typedef struct {
+    uint8_t dev_addr;        // 0 = free
+    uint8_t itf_num;
+    uint8_t protocol;
+    uint8_t ep_in;
+    uint8_t ep_out;
+    uint8_t in_index;        // Buffer the queued IN transfer lands in
+    bool    configured;
+    CFG_TUSB_MEM_ALIGN uint8_t in_buf[2][XINPUT_EP_BUFSIZE];
+    CFG_TUSB_MEM_ALIGN uint8_t out_buf[XINPUT_EP_BUFSIZE];
+} xinput_interface_t;
+
+CFG_TUSB_MEM_SECTION static xinput_interface_t xinput_itf[XINPUT_MAX_INTERFACES];
+
+static xinput_interface_t* find_interface(uint8_t dev_addr, uint8_t itf_num) {
+    for (int i = 0; i < XINPUT_MAX_INTERFACES; i++) {
+        if (xinput_itf[i].dev_addr == dev_addr && xinput_itf[i].itf_num == itf_num) {
+            return &xinput_itf[i];
+        }
+    }
+    return NULL;
+}
+
+static xinput_interface_t* find_endpoint(uint8_t dev_addr, uint8_t ep_addr) {
+    for (int i = 0; i < XINPUT_MAX_INTERFACES; i++) {
+        xinput_interface_t* itf = &xinput_itf[i];
+        if (itf->dev_addr == dev_addr && (itf->ep_in == ep_addr || itf->ep_out == ep_addr)) {
+            return itf;
+        }
+    }
+    return NULL;
+}
+
+static bool queue_in(xinput_interface_t* itf) {
+    if (!usbh_edpt_claim(itf->dev_addr, itf->ep_in)) {
+        return false;
+    }
+    if (!usbh_edpt_xfer(itf->dev_addr, itf->ep_in, itf->in_buf[itf->in_index], XINPUT_EP_BUFSIZE)) {
+        usbh_edpt_release(itf->dev_addr, itf->ep_in);
+        return false;
+    }
+    return true;
+}
+
+bool xinput_send(uint8_t dev_addr, uint8_t itf_num, const uint8_t* data, uint8_t len) {
+    xinput_interface_t* itf = find_interface(dev_addr, itf_num);
+    if (!itf || !itf->configured || !itf->ep_out || len > XINPUT_EP_BUFSIZE) {
+        return false;
+    }
+    if (!usbh_edpt_claim(dev_addr, itf->ep_out)) {
+        return false;
+    }
+    memcpy(itf->out_buf, data, len);
+    if (!usbh_edpt_xfer(dev_addr, itf->ep_out, itf->out_buf, len)) {
+        usbh_edpt_release(dev_addr, itf->ep_out);
+        return false;
+    }
+    return true;
+}
+
+bool xinput_set_led(uint8_t dev_addr, uint8_t itf_num, uint8_t pattern) {
+    xinput_interface_t* itf = find_interface(dev_addr, itf_num);
+    if (!itf) {
+        return false;
+    }
+    if (itf->protocol == XINPUT_PROTOCOL_WIRELESS) {
+        uint8_t msg[XINPUT_WIRELESS_MSG_LEN] = {0x00, 0x00, 0x08, 0x40 | pattern};
+        return xinput_send(dev_addr, itf_num, msg, sizeof(msg));
+    }
+    uint8_t msg[] = {XINPUT_MSG_LED, 3, pattern};
+    return xinput_send(dev_addr, itf_num, msg, sizeof(msg));
+}
+
+bool xinput_set_rumble(uint8_t dev_addr, uint8_t itf_num, uint8_t large, uint8_t small) {
+    xinput_interface_t* itf = find_interface(dev_addr, itf_num);
+    if (!itf) {
+        return false;
+    }
+    if (itf->protocol == XINPUT_PROTOCOL_WIRELESS) {
+        uint8_t msg[XINPUT_WIRELESS_MSG_LEN] = {0x00, 0x01, 0x0F, 0xC0, 0x00, large, small};
+        return xinput_send(dev_addr, itf_num, msg, sizeof(msg));
+    }
+    uint8_t msg[] = {XINPUT_MSG_RUMBLE, 8, 0x00, large, small, 0x00, 0x00, 0x00};
+    return xinput_send(dev_addr, itf_num, msg, sizeof(msg));
+}
+
+//--------------------------------------------------------------------
+// Class driver
+//--------------------------------------------------------------------
+
+static bool xinput_init(void) {
+    memset(xinput_itf, 0, sizeof(xinput_itf));
+    return true;
+}
+
+static bool xinput_deinit(void) {
+    return true;
+}
+
+static bool xinput_open(uint8_t rhport, uint8_t dev_addr, tusb_desc_interface_t const* desc_itf, uint16_t max_len) {
+    (void)rhport;
+    if (desc_itf->bInterfaceClass != TUSB_CLASS_VENDOR_SPECIFIC ||
+        desc_itf->bInterfaceSubClass != XINPUT_SUBCLASS ||
+        (desc_itf->bInterfaceProtocol != XINPUT_PROTOCOL_WIRED &&
+         desc_itf->bInterfaceProtocol != XINPUT_PROTOCOL_WIRELESS)) {
+        return false;
+    }
+
+    xinput_interface_t* itf = find_interface(0, 0);
+    if (!itf) {
+        printf("XInput: no free interface slot\n");
+        return false;
+    }
+
+    // The endpoints follow a vendor descriptor (type 0x21), skip anything that isn't one
+    uint8_t const* p = tu_desc_next(desc_itf);
+    uint8_t const* end = (uint8_t const*)desc_itf + max_len;
+    uint8_t found = 0;
+    while (p < end && found < desc_itf->bNumEndpoints) {
+        if (tu_desc_type(p) == TUSB_DESC_INTERFACE) {
+            break;
+        }
+        if (tu_desc_type(p) == TUSB_DESC_ENDPOINT) {
+            tusb_desc_endpoint_t const* ep = (tusb_desc_endpoint_t const*)p;
+            if (ep->bmAttributes.xfer == TUSB_XFER_INTERRUPT) {
+                if (!tuh_edpt_open(dev_addr, ep)) {
+                    memset(itf, 0, sizeof(*itf));
+                    return false;
+                }
+                if (tu_edpt_dir(ep->bEndpointAddress) == TUSB_DIR_IN) {
+                    itf->ep_in = ep->bEndpointAddress;
+                } else {
+                    itf->ep_out = ep->bEndpointAddress;
+                }
+            }
+            found++;
+        }
+        p = tu_desc_next(p);
+    }
+    if (!itf->ep_in) {
+        memset(itf, 0, sizeof(*itf));
+        return false;
+    }
+
+    itf->dev_addr = dev_addr;
+    itf->itf_num = desc_itf->bInterfaceNumber;
+    itf->protocol = desc_itf->bInterfaceProtocol;
+    itf->in_index = 0;
+    itf->configured = false;
+    return true;
+}
+
+static bool xinput_set_config(uint8_t dev_addr, uint8_t itf_num) {
+    xinput_interface_t* itf = find_interface(dev_addr, itf_num);
+    if (itf) {
+        itf->configured = true;
+        queue_in(itf);
+
+        // Pads already linked to a receiver only announce themselves when asked
+        if (itf->protocol == XINPUT_PROTOCOL_WIRELESS) {
+            static const uint8_t inquiry[XINPUT_WIRELESS_MSG_LEN] = {0x08, 0x00, 0x0F, 0xC0};
+            xinput_send(dev_addr, itf_num, inquiry, sizeof(inquiry));
+        }
+
+        xinput_mount_cb(dev_addr, itf_num, itf->protocol);
+    }
+    usbh_driver_set_config_complete(dev_addr, itf_num);
+    return true;
+}
+
+static bool xinput_xfer_cb(uint8_t dev_addr, uint8_t ep_addr, xfer_result_t result, uint32_t xferred_bytes) {
+    xinput_interface_t* itf = find_endpoint(dev_addr, ep_addr);
+    if (!itf) {
+        return false;
+    }
+    if (ep_addr != itf->ep_in) {
+        return true; // OUT done, the endpoint is free for the next message
+    }
+
+    // A stalled or failed endpoint would fail again at once, resubmitting it would only spin
+    // the host stack. The pad is dropped until it is plugged in again
+    if (result != XFER_RESULT_SUCCESS) {
+        printf("XInput: IN endpoint %02x on dev_addr=%d failed (%d), dropping it\n", ep_addr, dev_addr, result);
+        if (itf->configured) {
+            itf->configured = false;
+            xinput_umount_cb(dev_addr, itf->itf_num);
+        }
+        return true;
+    }
+
+    // Next poll goes into the other buffer before this one is looked at
+    uint8_t done = itf->in_index;
+    itf->in_index ^= 1;
+    queue_in(itf);
+
+    xinput_report_cb(dev_addr, itf->itf_num, itf->in_buf[done], xferred_bytes);
+    return true;
+}
+
+static void xinput_close(uint8_t dev_addr) {
+    for (int i = 0; i < XINPUT_MAX_INTERFACES; i++) {
+        xinput_interface_t* itf = &xinput_itf[i];
+        if (itf->dev_addr != dev_addr) {
+            continue;
+        }
+        if (itf->configured) {
+            xinput_umount_cb(dev_addr, itf->itf_num);
+        }
+        memset(itf, 0, sizeof(*itf));
+    }
+}
+
+static const usbh_class_driver_t xinput_driver = {
+    .name       = "XINPUT",
+    .init       = xinput_init,
+    .deinit     = xinput_deinit,
+    .open       = xinput_open,
+    .set_config = xinput_set_config,
+    .xfer_cb    = xinput_xfer_cb,
+    .close      = xinput_close,
+};
+
+// TinyUSB asks for application drivers at init, they are tried before the built-in ones
+usbh_class_driver_t const* usbh_app_driver_get_cb(uint8_t* driver_count) {
+    *driver_count = 1;
+    return &xinput_driver;
+}
@@ -0,0 +1,47 @@
+/*
+ * XInput USB Host Class Driver
+ * Vendor class (0xFF/0x5D) pads, claimed through TinyUSB's application driver hook
+ */
+
+#ifndef XINPUT_HOST_H
+#define XINPUT_HOST_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "tusb.h"
+
+// Interface triple of an XInput pad's control interface
+#define XINPUT_SUBCLASS          0x5D
+#define XINPUT_PROTOCOL_WIRED    0x01
+#define XINPUT_PROTOCOL_WIRELESS 0x81   // One per pad on the wireless receiver (045E:0719)
+
+// Input report: type, length, then the state (see xbox360_report_t)
+#define XINPUT_REPORT_INPUT      0x00
+#define XINPUT_REPORT_INPUT_LEN  0x14
+
+// LED ring patterns, 0x06-0x09 are "player 1-4, steady"
+#define XINPUT_LED_PLAYER1       0x06
+
+// Pad interfaces at once: the four of a wireless receiver, or pads behind a hub
+#define XINPUT_MAX_INTERFACES    4
+
+#define XINPUT_EP_BUFSIZE        32
+
+// Queues a message on the pad's OUT endpoint (LEDs, rumble). False if the last one
+// is still going or the pad has no OUT endpoint
+bool xinput_send(uint8_t dev_addr, uint8_t itf_num, const uint8_t* data, uint8_t len);
+
+// LED ring, in whichever message format the interface takes
+bool xinput_set_led(uint8_t dev_addr, uint8_t itf_num, uint8_t pattern);
+
+// Motor speeds, 0-255: large is the low-frequency (left) motor, small the high one
+bool xinput_set_rumble(uint8_t dev_addr, uint8_t itf_num, uint8_t large, uint8_t small);
+
+// Implemented by the application. Called from tuh_task(). The report points into the
+// driver's buffer and is only valid during the call. A wireless interface mounts with the
+// receiver, whether or not a pad is linked to it
+void xinput_mount_cb(uint8_t dev_addr, uint8_t itf_num, uint8_t protocol);
+void xinput_umount_cb(uint8_t dev_addr, uint8_t itf_num);
+void xinput_report_cb(uint8_t dev_addr, uint8_t itf_num, const uint8_t* report, uint16_t len);
+
+#endif // XINPUT_HOST_H
@@ -0,0 +1,100 @@
+#!/usr/bin/env python3
+"""
+Font atlas generator
+Dreamcast controller emulator for Raspberry Pi Pico (RP2040/RP2350)
+
+Reads the glyph images in src/font.c (lcd-image-converter output: a byte per
+row, clear bits are ink, stored mirrored so screen column c is bit 8 - width + c)
+and writes a table indexed directly by
+character, FONT_FIRST_CHAR to FONT_LAST_CHAR, in the layouts the panel
+drivers draw from (see src/font_atlas.h):
+
+  fontColumns  monochrome panels, a word per column with bit r for row r,
+               shifted and ORed into the byte pages as is
+  fontMasks    RGB565 panels, 0xFFFF for every ink pixel, row after row
+
+Characters the font doesn't have come out blank, like a space.
+
+Usage: font_atlas.py src/font.c font_atlas.c
+"""
+
+import re
+import sys
+
+FIRST_CHAR = 0x20
+LAST_CHAR = 0x7E
+
+IMAGE_DATA = re.compile(r"image_data_Font_(0x[0-9a-fA-F]+)\[\d+\]\s*=\s*\{(.*?)\};", re.S)
+IMAGE = re.compile(r"tImage\s+Font_(0x[0-9a-fA-F]+)\s*=\s*\{\s*image_data_Font_\w+\s*,\s*(\d+)\s*,\s*(\d+)\s*,")
+
+
+def load_font(path):
+    with open(path) as f:
+        source = f.read()
+    # Drop the pixel-art comments, they're made of the same characters as nothing else
+    source = re.sub(r"//[^\n]*", "", source)
+
+    rows = {}
+    for code, body in IMAGE_DATA.findall(source):
+        rows[int(code, 16)] = [int(v, 16) for v in re.findall(r"0x[0-9a-fA-F]+", body)]
+
+    size = None
+    for code, width, height in IMAGE.findall(source):
+        dims = (int(width), int(height))
+        if size is not None and dims != size:
+            sys.exit("font_atlas: glyph 0x%02x is %dx%d, the atlas needs one size" % ((int(code, 16),) + dims))
+        size = dims
+    if size is None or not rows:
+        sys.exit("font_atlas: no glyphs in " + path)
+    return rows, size
+
+
+def ink(row_byte, column, width):
+    return not (row_byte & (1 << (8 - width + column)))
+
+
+def main():
+    if len(sys.argv) != 3:
+        sys.exit(__doc__)
+    glyphs, (width, height) = load_font(sys.argv[1])
+    if width > 8 or height > 16:
+        sys.exit("font_atlas: %dx%d glyphs don't fit a byte per row and a word per column" % (width, height))
+
+    out = []
+    out.append("// Generated by tools/font_atlas.py from src/font.c, do not edit")
+    out.append("")
+    out.append('#include "font_atlas.h"')
+    out.append("")
+    out.append("#if FONT_WIDTH != %d || FONT_HEIGHT != %d" % (width, height))
+    out.append('#error "font_atlas.h doesn\'t match the glyphs in font.c"')
+    out.append("#endif")
+    out.append("")
+
+    columns = []
+    masks = []
+    for code in range(FIRST_CHAR, LAST_CHAR + 1):
+        rows = glyphs.get(code, [])
+        rows = (rows + [0xFF] * height)[:height]
+        label = repr(chr(code)) if code != 0x5C else "'\\\\'"
+        columns.append((label, [sum(1 << r for r in range(height) if ink(rows[r], c, width)) for c in range(width)]))
+        masks.append((label, [0xFFFF if ink(rows[r], c, width) else 0 for r in range(height) for c in range(width)]))
+
+    out.append("const uint16_t fontColumns[FONT_GLYPHS][FONT_WIDTH] = {")
+    for label, words in columns:
+        out.append("    {%s}, // %s" % (", ".join("0x%04x" % w for w in words), label))
+    out.append("};")
+    out.append("")
+    out.append("const uint16_t fontMasks[FONT_GLYPHS][FONT_HEIGHT * FONT_WIDTH] = {")
+    for label, words in masks:
+        out.append("    { // %s" % label)
+        for r in range(height):
+            out.append("        %s," % ", ".join("0x%04x" % w for w in words[r * width:(r + 1) * width]))
+        out.append("    },")
+    out.append("};")
+
+    with open(sys.argv[2], "w") as f:
+        f.write("\n".join(out) + "\n")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,70 @@
+#!/usr/bin/env python3
+"""
+Trace decoder
+Dreamcast controller emulator for Raspberry Pi Pico (RP2040/RP2350)
+
+Splits a raw capture of the stdio UART into console text and trace records
+(see src/trace.h). Every record is TRACE_FRAME_START followed by 16 bytes:
+id (u16), core (u8), dropped (u8), time_us, arg0, arg1 (u32), little endian.
+Record names are read from the trace_id_t enum, so they stay in step with
+the firmware.
+
+Usage: trace_decode.py capture.bin [src/trace.h]
+"""
+
+import os
+import re
+import struct
+import sys
+
+FRAME_START = 0x1E
+RECORD = struct.Struct("<HBBIII")
+
+
+def load_names(path):
+    with open(path) as f:
+        source = f.read()
+    body = re.search(r"typedef enum\s*\{(.*?)\}\s*trace_id_t;", source, re.S).group(1)
+    body = re.sub(r"//[^\n]*", "", body)
+    names = []
+    for entry in body.split(","):
+        entry = entry.strip()
+        if not entry:
+            continue
+        name, _, value = entry.partition("=")
+        index = int(value, 0) if value.strip() else len(names)
+        names.extend([None] * (index - len(names)))
+        names.append(name.strip())
+    return names
+
+
+def decode(data, names):
+    text = bytearray()
+    i = 0
+    while i < len(data):
+        if data[i] != FRAME_START or i + 1 + RECORD.size > len(data):
+            text.append(data[i])
+            i += 1
+            continue
+        if text:
+            sys.stdout.write(text.decode("ascii", "replace"))
+            text.clear()
+        ident, core, dropped, time_us, arg0, arg1 = RECORD.unpack_from(data, i + 1)
+        name = names[ident] if ident < len(names) and names[ident] else "TRACE_%d" % ident
+        if dropped:
+            print("  core %d: %s%d records dropped" % (core, "at least " if dropped == 255 else "", dropped))
+        print("  %10u core %d %-24s %08x %08x" % (time_us, core, name, arg0, arg1))
+        i += 1 + RECORD.size
+    sys.stdout.write(text.decode("ascii", "replace"))
+
+
+def main():
+    if len(sys.argv) not in (2, 3):
+        sys.exit(__doc__.strip().splitlines()[-1])
+    header = sys.argv[2] if len(sys.argv) == 3 else os.path.join(os.path.dirname(__file__), "..", "src", "trace.h")
+    with open(sys.argv[1], "rb") as f:
+        decode(f.read(), load_names(header))
+
+
+if __name__ == "__main__":
+    main()